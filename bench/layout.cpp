@@ -0,0 +1,241 @@
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include "../src/RangeTree.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Pointer-free implicit layout against the node-per-allocation layout it replaced.
+// The baseline below is a 2D tree of heap nodes with a pointer-linked 1D tree
+// hanging off every node; both answer the same canonical decomposition.
+
+// Hardware cache-miss counter for the calling thread; reports -1 where perf is unavailable
+class CacheMisses {
+public:
+    CacheMisses() : fd(-1) {
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~CacheMisses() {
+#if defined(__linux__)
+        if (fd >= 0) close(fd);
+#endif
+    }
+    
+    void start() {
+#if defined(__linux__)
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+    
+    long long stop() {
+#if defined(__linux__)
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+        return count;
+#else
+        return -1;
+#endif
+    }
+
+private:
+    int fd;
+};
+
+using Point = std::array<int, 2>;
+
+// Node-per-allocation baseline: each node owns its children and, in x, its associated y tree
+struct PointerTree {
+    struct Node {
+        uint32_t point;
+        uint32_t begin, end; // Subtree range of order
+        std::unique_ptr<Node> left, right;
+        std::unique_ptr<PointerTree> next_level;
+    };
+    
+    const std::vector<Point>* points;
+    size_t dim;
+    std::vector<uint32_t> order;
+    std::unique_ptr<Node> root;
+    
+    PointerTree(const std::vector<Point>* pts, std::vector<uint32_t> indices, size_t d)
+        : points(pts), dim(d), order(std::move(indices)) {
+        std::sort(order.begin(), order.end(),
+                  [this](uint32_t a, uint32_t b) { return key(a) < key(b); });
+        root = build(0, static_cast<uint32_t>(order.size()));
+    }
+    
+    int key(uint32_t point) const { return (*points)[point][dim]; }
+    
+    std::unique_ptr<Node> build(uint32_t begin, uint32_t end) {
+        if (begin >= end) return nullptr;
+        std::unique_ptr<Node> node(new Node());
+        uint32_t mid = begin + (end - begin) / 2;
+        node->point = order[mid];
+        node->begin = begin;
+        node->end = end;
+        node->left = build(begin, mid);
+        node->right = build(mid + 1, end);
+        if (dim == 0) {
+            node->next_level.reset(new PointerTree(points,
+                std::vector<uint32_t>(order.begin() + begin, order.begin() + end), 1));
+        }
+        return node;
+    }
+    
+    void report(const Node* node, const Point& low, const Point& high, std::vector<uint32_t>& out) const {
+        if (!node) return;
+        if (dim == 0) {
+            node->next_level->query(low, high, out);
+        } else {
+            out.insert(out.end(), order.begin() + node->begin, order.begin() + node->end);
+        }
+    }
+    
+    void check(uint32_t point, const Point& low, const Point& high, std::vector<uint32_t>& out) const {
+        const Point& p = (*points)[point];
+        if (p[1] >= low[1] && p[1] <= high[1]) out.push_back(point);
+    }
+    
+    void query(const Point& low, const Point& high, std::vector<uint32_t>& out) const {
+        const Node* split = root.get();
+        while (split && (key(split->point) < low[dim] || key(split->point) > high[dim])) {
+            split = key(split->point) < low[dim] ? split->right.get() : split->left.get();
+        }
+        if (!split) return;
+        check(split->point, low, high, out);
+        
+        for (const Node* node = split->left.get(); node;) {
+            if (key(node->point) < low[dim]) { node = node->right.get(); continue; }
+            check(node->point, low, high, out);
+            report(node->right.get(), low, high, out);
+            node = node->left.get();
+        }
+        for (const Node* node = split->right.get(); node;) {
+            if (key(node->point) > high[dim]) { node = node->left.get(); continue; }
+            check(node->point, low, high, out);
+            report(node->left.get(), low, high, out);
+            node = node->right.get();
+        }
+    }
+    
+    size_t rangeCount(const Point& low, const Point& high) const {
+        std::vector<uint32_t> out;
+        query(low, high, out);
+        return out.size();
+    }
+};
+
+struct ImplicitTree {
+    RangeTree<int, 2> tree;
+    size_t rangeCount(const Point& low, const Point& high) const { return tree.rangeSearch(low, high).size(); }
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double millisSince(Clock::time_point start) {
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+template<typename Tree>
+void runQueries(const char* layout, size_t n, const Tree& tree, const std::vector<std::pair<Point, Point>>& boxes,
+                double build_ms, size_t& hits) {
+    CacheMisses misses;
+    hits = 0;
+    misses.start();
+    auto start = Clock::now();
+    for (const auto& box : boxes) {
+        hits += tree.rangeCount(box.first, box.second);
+    }
+    double query_ms = millisSince(start);
+    long long missed = misses.stop();
+    
+    std::cout << layout << "\t" << n << "\t" << build_ms << "\t"
+              << query_ms * 1000.0 / boxes.size() << "\t";
+    if (missed < 0) {
+        std::cout << "n/a";
+    } else {
+        std::cout << static_cast<double>(missed) / boxes.size();
+    }
+}
+
+int main() {
+    const size_t sizes[] = {4096, 65536, 262144};
+    const int queries = 20000;
+    
+    std::cout << "layout\tn\tbuild_ms\tus_per_query\tmisses_per_query\tteardown_ms" << std::endl;
+    
+    for (size_t n : sizes) {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> coord(0, static_cast<int>(n) - 1);
+        std::vector<Point> points(n);
+        for (auto& point : points) {
+            point = {{coord(rng), coord(rng)}};
+        }
+        
+        // Small square boxes, so the cost is dominated by the descents
+        std::vector<std::pair<Point, Point>> boxes;
+        for (int q = 0; q < queries; ++q) {
+            int x = coord(rng), y = coord(rng);
+            boxes.push_back({{{x, y}}, {{x + 64, y + 64}}});
+        }
+        
+        size_t pointer_hits = 0, implicit_hits = 0, arena_hits = 0;
+        {
+            auto start = Clock::now();
+            std::unique_ptr<PointerTree> tree(new PointerTree(&points, pointIndices(n), 0));
+            runQueries("pointer", n, *tree, boxes, millisSince(start), pointer_hits);
+            start = Clock::now();
+            tree.reset();
+            std::cout << "\t" << millisSince(start) << std::endl;
+        }
+        {
+            auto start = Clock::now();
+            std::unique_ptr<ImplicitTree> tree(new ImplicitTree{RangeTree<int, 2>(points)});
+            runQueries("implicit", n, *tree, boxes, millisSince(start), implicit_hits);
+            start = Clock::now();
+            tree.reset();
+            std::cout << "\t" << millisSince(start) << std::endl;
+        }
+        {
+            BuildOptions options;
+            options.arena = std::make_shared<Arena>(size_t(64) << 20);
+            auto start = Clock::now();
+            std::unique_ptr<ImplicitTree> tree(new ImplicitTree{RangeTree<int, 2>(points, options)});
+            options.arena.reset();
+            runQueries("arena", n, *tree, boxes, millisSince(start), arena_hits);
+            start = Clock::now();
+            tree.reset();
+            std::cout << "\t" << millisSince(start) << std::endl;
+        }
+        
+        if (pointer_hits != implicit_hits || arena_hits != implicit_hits) {
+            std::cerr << "Layouts disagree at n = " << n << std::endl;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
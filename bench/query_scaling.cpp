@@ -0,0 +1,72 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include "../src/RangeTree.h"
+
+// Wide-slab 2D queries with a fixed expected output size.
+// The slab in x always holds half of the points, so a traversal that walks the
+// whole slab grows with n, while the canonical decomposition stays polylogarithmic.
+template<typename Tree, typename Boxes>
+double microsPerQuery(const Tree& tree, const Boxes& boxes, size_t& hits) {
+    hits = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto& box : boxes) {
+        hits += tree.rangeSearch(box.first, box.second).size();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    
+    std::chrono::duration<double, std::micro> elapsed = end - start;
+    return elapsed.count() / boxes.size();
+}
+
+int main() {
+    const size_t sizes[] = {1024, 4096, 16384, 65536, 262144};
+    const int queries = 2000;
+    const int y_width = 64; // ~32 expected hits per query
+    
+    BuildOptions cascading;
+    cascading.fractional_cascading = true;
+    
+    std::cout << "n\tslab_points\tavg_hits\tus_per_query\tus_cascading" << std::endl;
+    
+    for (size_t n : sizes) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> coord(0, static_cast<int>(n) - 1);
+        
+        std::vector<RangeTree<int, 2>::Point> points(n);
+        for (auto& point : points) {
+            point = {{coord(rng), coord(rng)}};
+        }
+        
+        RangeTree<int, 2> tree(points);
+        RangeTree<int, 2> layered(points, cascading);
+        
+        const int x_low = static_cast<int>(n / 4);
+        const int x_high = static_cast<int>(3 * n / 4);
+        size_t slab_points = 0;
+        for (const auto& point : points) {
+            if (point[0] >= x_low && point[0] <= x_high) slab_points++;
+        }
+        
+        std::vector<std::pair<RangeTree<int, 2>::Point, RangeTree<int, 2>::Point>> boxes;
+        for (int q = 0; q < queries; ++q) {
+            int y = coord(rng);
+            boxes.push_back({{{x_low, y}}, {{x_high, y + y_width}}});
+        }
+        
+        size_t hits = 0, layered_hits = 0;
+        double us = microsPerQuery(tree, boxes, hits);
+        double us_layered = microsPerQuery(layered, boxes, layered_hits);
+        if (hits != layered_hits) {
+            std::cerr << "Layouts disagree at n = " << n << std::endl;
+            return 1;
+        }
+        
+        std::cout << n << "\t" << slab_points << "\t\t"
+                  << static_cast<double>(hits) / queries << "\t\t"
+                  << us << "\t\t" << us_layered << std::endl;
+    }
+    
+    return 0;
+}
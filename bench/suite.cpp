@@ -0,0 +1,171 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "../src/RangeTree.h"
+
+// Scaling sweep over tree size, dimension, point distribution and query selectivity.
+// Every configuration is one tab-separated row on stdout, so runs can be diffed or
+// loaded as a table; progress and skipped configurations go to stderr.
+//
+// Usage: bench_suite [max_n [queries [budget_mb]]]
+//   max_n      largest tree size of the sweep, from 1e3 up in powers of ten (1e6)
+//   queries    timed queries per configuration (1000)
+//   budget_mb  configurations expected to need more tree memory are skipped (4096)
+
+typedef std::chrono::steady_clock Clock;
+
+double microsSince(Clock::time_point start) {
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+enum class Distribution { Uniform, Clustered, Skewed };
+
+const char* distributionName(Distribution distribution) {
+    switch (distribution) {
+    case Distribution::Uniform: return "uniform";
+    case Distribution::Clustered: return "clustered";
+    default: return "skewed";
+    }
+}
+
+// Coordinates in [0, n): uniform, around a few dense gaussian centres, or crowding
+// towards zero with a power law
+template<size_t K>
+std::vector<std::array<int, K>> makePoints(size_t n, Distribution distribution, std::mt19937_64& rng) {
+    const double extent = static_cast<double>(n);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<std::array<double, K>> centres(16);
+    for (auto& centre : centres) {
+        for (size_t d = 0; d < K; ++d) centre[d] = unit(rng) * extent;
+    }
+    std::normal_distribution<double> spread(0.0, extent / 200.0);
+    
+    std::vector<std::array<int, K>> points(n);
+    for (auto& point : points) {
+        const auto& centre = centres[rng() % centres.size()];
+        for (size_t d = 0; d < K; ++d) {
+            double value;
+            if (distribution == Distribution::Uniform) {
+                value = unit(rng) * extent;
+            } else if (distribution == Distribution::Clustered) {
+                value = centre[d] + spread(rng);
+            } else {
+                value = std::pow(unit(rng), 4.0) * extent;
+            }
+            point[d] = static_cast<int>(std::min(std::max(value, 0.0), extent - 1));
+        }
+    }
+    return points;
+}
+
+// Boxes that each hold about selectivity * n points: centred on a random point, each
+// side spans selectivity^(1/K) of the points by rank in its dimension
+template<size_t K>
+std::vector<typename RangeTree<int, K>::Box> makeBoxes(const std::vector<std::array<int, K>>& points,
+                                                       double selectivity, size_t count, std::mt19937_64& rng) {
+    const size_t n = points.size();
+    std::vector<std::vector<int>> sorted(K, std::vector<int>(n));
+    for (size_t d = 0; d < K; ++d) {
+        for (size_t i = 0; i < n; ++i) sorted[d][i] = points[i][d];
+        std::sort(sorted[d].begin(), sorted[d].end());
+    }
+    
+    const size_t width = static_cast<size_t>(std::pow(selectivity, 1.0 / K) * n);
+    std::vector<typename RangeTree<int, K>::Box> boxes(count);
+    for (auto& box : boxes) {
+        const auto& centre = points[rng() % n];
+        for (size_t d = 0; d < K; ++d) {
+            const size_t rank = std::lower_bound(sorted[d].begin(), sorted[d].end(), centre[d]) - sorted[d].begin();
+            box.low[d] = sorted[d][rank > width / 2 ? rank - width / 2 : 0];
+            box.high[d] = sorted[d][std::min(n - 1, rank + width / 2)];
+        }
+    }
+    return boxes;
+}
+
+// Expected tree bytes: every level stores its order and keys, plus the point columns
+size_t estimatedBytes(size_t n, size_t k) {
+    const double levels = std::pow(std::max(1.0, std::log2(static_cast<double>(n)) - 4.0), static_cast<double>(k - 1));
+    return static_cast<size_t>(n * (levels * 8.0 + k * 4.0));
+}
+
+template<size_t K>
+void runDimension(size_t max_n, size_t queries, size_t budget) {
+    const Distribution distributions[] = {Distribution::Uniform, Distribution::Clustered, Distribution::Skewed};
+    const double selectivities[] = {1e-5, 1e-3, 1e-1};
+    
+    for (Distribution distribution : distributions) {
+        for (size_t n = 1000; n <= max_n; n *= 10) {
+            if (estimatedBytes(n, K) > budget) {
+                std::cerr << "skipping " << distributionName(distribution) << " K=" << K << " n=" << n
+                          << ": over the memory budget" << std::endl;
+                continue;
+            }
+            std::cerr << distributionName(distribution) << " K=" << K << " n=" << n << std::endl;
+            
+            std::mt19937_64 rng(n * 31 + K);
+            auto points = makePoints<K>(n, distribution, rng);
+            
+            // An arena holds every array of the tree, so its use is the tree's footprint
+            BuildOptions options;
+            options.arena = std::make_shared<Arena>();
+            auto start = Clock::now();
+            RangeTree<int, K> tree(points, options);
+            const double build_us = microsSince(start);
+            const double bytes_per_point = static_cast<double>(options.arena->bytesUsed()) / n;
+            
+            for (double selectivity : selectivities) {
+                auto boxes = makeBoxes<K>(points, selectivity, queries, rng);
+                std::vector<double> latencies;
+                latencies.reserve(boxes.size());
+                std::vector<uint32_t> hits;
+                size_t total_hits = 0;
+                double total_us = 0;
+                for (const auto& box : boxes) {
+                    hits.clear();
+                    start = Clock::now();
+                    tree.rangeSearch(box.low, box.high, [&hits](uint32_t index, const int*) {
+                        hits.push_back(index);
+                        return true;
+                    });
+                    latencies.push_back(microsSince(start));
+                    total_us += latencies.back();
+                    total_hits += hits.size();
+                }
+                std::sort(latencies.begin(), latencies.end());
+                
+                std::cout << distributionName(distribution) << "\t" << K << "\t" << n << "\t" << selectivity << "\t"
+                          << build_us / 1000.0 << "\t" << n / (build_us / 1e6) << "\t" << bytes_per_point << "\t"
+                          << boxes.size() << "\t" << static_cast<double>(total_hits) / boxes.size() << "\t"
+                          << latencies[latencies.size() / 2] << "\t"
+                          << latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)] << "\t"
+                          << (total_us > 0 ? total_hits / (total_us / 1e6) : 0.0) << std::endl;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t max_n = argc > 1 ? static_cast<size_t>(std::atof(argv[1])) : 1000000;
+    const size_t queries = argc > 2 ? static_cast<size_t>(std::atol(argv[2])) : 1000;
+    const size_t budget = (argc > 3 ? static_cast<size_t>(std::atol(argv[3])) : 4096) << 20;
+    if (max_n < 1000 || max_n > std::numeric_limits<uint32_t>::max() || queries == 0) {
+        std::cerr << "Usage: bench_suite [max_n >= 1000 [queries > 0 [budget_mb]]]" << std::endl;
+        return 1;
+    }
+    
+    std::cout << "distribution\tK\tn\tselectivity\tbuild_ms\tbuild_points_per_s\tbytes_per_point\t"
+              << "queries\tavg_hits\tp50_us\tp99_us\thits_per_s" << std::endl;
+    runDimension<1>(max_n, queries, budget);
+    runDimension<2>(max_n, queries, budget);
+    runDimension<3>(max_n, queries, budget);
+    runDimension<4>(max_n, queries, budget);
+    return 0;
+}
@@ -0,0 +1,213 @@
+// AggregateRangeTree.h
+#pragma once
+
+#include "RangeTree.h"
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+// Side tables of a built tree, one per array its canonical decomposition reports slices
+// of: each level's order and each cascade subset. A slice is matched back to its
+// table by the address it points into.
+template<typename Table>
+class SliceTables {
+public:
+    struct Entry {
+        const uint32_t* base;
+        Table table;
+    };
+    
+    // make(array) builds the table of one array
+    template<typename T, size_t K, typename Compare, typename Make>
+    void build(const RangeTree<T, K, Compare>& tree, Make make);
+    
+    // Entry of the array holding the slice that starts at first
+    const Entry& find(const uint32_t* first) const;
+    
+    // Canonical decomposition of a box, as sink.point(index) and sink.slice(first, last)
+    template<typename T, size_t K, typename Compare, typename Sink>
+    static void decompose(const RangeTree<T, K, Compare>& tree, const std::array<T, K>& low,
+                          const std::array<T, K>& high, Sink& sink) {
+        tree.rangeSearchDim(0, static_cast<uint32_t>(tree.order.size()), low.data(), high.data(), sink);
+    }
+    template<typename T, size_t K, typename Compare, typename Sink>
+    static void decompose(const RangeTree<T, K, Compare>& tree, const QueryBox<T, K>& box, Sink& sink) {
+        tree.searchBox(box, sink);
+    }
+
+private:
+    std::vector<Entry> entries; // Sorted by base
+    
+    // Helper methods
+    template<typename T, size_t J, typename Compare, size_t Axis, typename Make>
+    void addLevel(const RangeTree<T, J, Compare, Axis>& level, Make& make);
+    template<typename T, typename Compare, size_t Axis, typename Make>
+    void addLevel(const RangeTree<T, 1, Compare, Axis>& level, Make& make);
+    template<typename Make>
+    void addArray(const FlatArray<uint32_t>& array, Make& make);
+};
+
+template<typename Table>
+template<typename T, size_t K, typename Compare, typename Make>
+void SliceTables<Table>::build(const RangeTree<T, K, Compare>& tree, Make make) {
+    addLevel(tree, make);
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return std::less<const uint32_t*>()(a.base, b.base);
+    });
+}
+
+template<typename Table>
+template<typename T, size_t J, typename Compare, size_t Axis, typename Make>
+void SliceTables<Table>::addLevel(const RangeTree<T, J, Compare, Axis>& level, Make& make) {
+    addArray(level.order, make);
+    for (const FlatArray<uint32_t>& subset : level.cascade) {
+        addArray(subset, make);
+    }
+    for (const auto& next : level.next_level) {
+        addLevel(next, make);
+    }
+}
+
+template<typename Table>
+template<typename T, typename Compare, size_t Axis, typename Make>
+void SliceTables<Table>::addLevel(const RangeTree<T, 1, Compare, Axis>& level, Make& make) {
+    addArray(level.order, make);
+}
+
+template<typename Table>
+template<typename Make>
+void SliceTables<Table>::addArray(const FlatArray<uint32_t>& array, Make& make) {
+    if (array.size() == 0) return;
+    entries.push_back(Entry{array.data(), make(array)});
+}
+
+template<typename Table>
+const typename SliceTables<Table>::Entry& SliceTables<Table>::find(const uint32_t* first) const {
+    // The last array starting at or before the slice is the one holding it
+    auto after = std::upper_bound(entries.begin(), entries.end(), first, [](const uint32_t* p, const Entry& e) {
+        return std::less<const uint32_t*>()(p, e.base);
+    });
+    return *(after - 1);
+}
+
+// Monoids for rangeAggregate: an identity and an associative, commutative combine
+template<typename V>
+struct SumOf {
+    static V identity() { return V(); }
+    static V combine(const V& a, const V& b) { return a + b; }
+};
+
+template<typename V>
+struct MinOf {
+    static V identity() {
+        return std::numeric_limits<V>::has_infinity ? std::numeric_limits<V>::infinity() : std::numeric_limits<V>::max();
+    }
+    static V combine(const V& a, const V& b) { return std::min(a, b); }
+};
+
+template<typename V>
+struct MaxOf {
+    static V identity() {
+        return std::numeric_limits<V>::has_infinity ? -std::numeric_limits<V>::infinity() : std::numeric_limits<V>::lowest();
+    }
+    static V combine(const V& a, const V& b) { return std::max(a, b); }
+};
+
+// Range tree over points carrying one value each, answering the monoid aggregate of the
+// values in a box without enumerating its points. Every array the canonical
+// decomposition reports slices of gets a parallel segment tree of values, so a slice
+// costs O(log n) combines instead of one per point. Only points on the boundary paths
+// and in leaf buckets are combined one at a time.
+template<typename T, size_t K, typename V, typename Monoid = SumOf<V>, typename Compare = std::less<T>>
+class AggregateRangeTree {
+public:
+    using Point = std::array<T, K>;
+    
+    // values[i] belongs to points[i]
+    AggregateRangeTree(const std::vector<Point>& points, std::vector<V> point_values,
+                       const BuildOptions& opts = BuildOptions());
+    
+    V rangeAggregate(const Point& low, const Point& high) const;
+    V rangeAggregate(const QueryBox<T, K>& box) const;
+    
+    // The underlying tree, for the plain queries
+    const RangeTree<T, K, Compare>& rangeTree() const { return tree; }
+
+private:
+    // Bottom-up segment tree over one array: leaf i is at nodes[size + i]
+    struct Segments {
+        size_t size;
+        std::vector<V> nodes;
+        
+        V combine(size_t first, size_t last) const;
+    };
+    
+    // Folds the hits of one query: slices through their segment trees, points one by one
+    struct AggregateSink {
+        const AggregateRangeTree& tree;
+        V total;
+        
+        bool point(uint32_t index) {
+            total = Monoid::combine(total, tree.values[index]);
+            return true;
+        }
+        bool slice(const uint32_t* first, const uint32_t* last) {
+            const auto& entry = tree.segments.find(first);
+            total = Monoid::combine(total, entry.table.combine(first - entry.base, last - entry.base));
+            return true;
+        }
+    };
+    
+    RangeTree<T, K, Compare> tree;
+    std::vector<V> values; // By input position
+    SliceTables<Segments> segments;
+};
+
+template<typename T, size_t K, typename V, typename Monoid, typename Compare>
+AggregateRangeTree<T, K, V, Monoid, Compare>::AggregateRangeTree(const std::vector<Point>& points,
+                                                                 std::vector<V> point_values, const BuildOptions& opts)
+    : tree(points, opts), values(std::move(point_values)) {
+    if (values.size() != points.size()) {
+        throw std::invalid_argument("Every point needs exactly one value");
+    }
+    
+    segments.build(tree, [this](const FlatArray<uint32_t>& array) {
+        Segments built;
+        built.size = array.size();
+        built.nodes.resize(2 * built.size, Monoid::identity());
+        for (size_t i = 0; i < built.size; ++i) {
+            built.nodes[built.size + i] = values[array[i]];
+        }
+        for (size_t node = built.size - 1; node > 0; --node) {
+            built.nodes[node] = Monoid::combine(built.nodes[2 * node], built.nodes[2 * node + 1]);
+        }
+        return built;
+    });
+}
+
+template<typename T, size_t K, typename V, typename Monoid, typename Compare>
+V AggregateRangeTree<T, K, V, Monoid, Compare>::Segments::combine(size_t first, size_t last) const {
+    V total = Monoid::identity();
+    for (first += size, last += size; first < last; first /= 2, last /= 2) {
+        if (first & 1) total = Monoid::combine(total, nodes[first++]);
+        if (last & 1) total = Monoid::combine(total, nodes[--last]);
+    }
+    return total;
+}
+
+template<typename T, size_t K, typename V, typename Monoid, typename Compare>
+V AggregateRangeTree<T, K, V, Monoid, Compare>::rangeAggregate(const Point& low, const Point& high) const {
+    AggregateSink sink{*this, Monoid::identity()};
+    SliceTables<Segments>::decompose(tree, low, high, sink);
+    return sink.total;
+}
+
+template<typename T, size_t K, typename V, typename Monoid, typename Compare>
+V AggregateRangeTree<T, K, V, Monoid, Compare>::rangeAggregate(const QueryBox<T, K>& box) const {
+    AggregateSink sink{*this, Monoid::identity()};
+    SliceTables<Segments>::decompose(tree, box, sink);
+    return sink.total;
+}
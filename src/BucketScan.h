@@ -0,0 +1,201 @@
+// BucketScan.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Branch-free filters over small buckets of points stored column by column.
+// A mask has bit i set when position first + i of a bucket lies inside the box;
+// a point is inside when no coordinate is below its low or above its high bound,
+// the same test the scalar descent makes (so a NaN coordinate is never excluded).
+// The vector kernels serve the natural order of their type; any other comparator
+// takes the portable loop.
+
+// Mask with the low count bits set, count at most 64
+inline uint64_t lowBits(size_t count) {
+    return count >= 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+}
+
+// Index of the lowest set bit of a non-zero mask
+inline unsigned lowestBit(uint64_t mask) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#else
+    unsigned bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// Natural order that never resolves to a vector kernel, for the tails of full vectors
+template<typename T>
+struct Portable : std::less<T> {};
+
+// Portable kernel: one compare pair per value, folded into the mask without branches
+template<typename T, typename Compare>
+uint64_t columnMask(const T* values, size_t count, const T& low, const T& high, Compare less) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const bool inside = !less(values[i], low) & !less(high, values[i]);
+        mask |= static_cast<uint64_t>(inside) << i;
+    }
+    return mask;
+}
+
+#if defined(__AVX512F__)
+
+inline uint64_t columnMask(const int32_t* values, size_t count, const int32_t& low, const int32_t& high,
+                           std::less<int32_t>) {
+    const __m512i lo = _mm512_set1_epi32(low), hi = _mm512_set1_epi32(high);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i += 16) {
+        const __mmask16 lanes = static_cast<__mmask16>(lowBits(count - i));
+        const __m512i v = _mm512_maskz_loadu_epi32(lanes, values + i);
+        const __mmask16 inside = _mm512_mask_cmpge_epi32_mask(lanes, v, lo) & _mm512_cmple_epi32_mask(v, hi);
+        mask |= static_cast<uint64_t>(inside) << i;
+    }
+    return mask;
+}
+
+inline uint64_t columnMask(const float* values, size_t count, const float& low, const float& high,
+                           std::less<float>) {
+    const __m512 lo = _mm512_set1_ps(low), hi = _mm512_set1_ps(high);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i += 16) {
+        const __mmask16 lanes = static_cast<__mmask16>(lowBits(count - i));
+        const __m512 v = _mm512_maskz_loadu_ps(lanes, values + i);
+        const __mmask16 inside = _mm512_mask_cmp_ps_mask(lanes, v, lo, _CMP_NLT_UQ) &
+                                 _mm512_cmp_ps_mask(v, hi, _CMP_NGT_UQ);
+        mask |= static_cast<uint64_t>(inside) << i;
+    }
+    return mask;
+}
+
+inline uint64_t columnMask(const double* values, size_t count, const double& low, const double& high,
+                           std::less<double>) {
+    const __m512d lo = _mm512_set1_pd(low), hi = _mm512_set1_pd(high);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i += 8) {
+        const __mmask8 lanes = static_cast<__mmask8>(lowBits(count - i));
+        const __m512d v = _mm512_maskz_loadu_pd(lanes, values + i);
+        const __mmask8 inside = _mm512_mask_cmp_pd_mask(lanes, v, lo, _CMP_NLT_UQ) &
+                                _mm512_cmp_pd_mask(v, hi, _CMP_NGT_UQ);
+        mask |= static_cast<uint64_t>(inside) << i;
+    }
+    return mask;
+}
+
+#elif defined(__AVX2__)
+
+// Full vectors only; the tail of a bucket falls back to the portable kernel
+inline uint64_t columnMask(const int32_t* values, size_t count, const int32_t& low, const int32_t& high,
+                           std::less<int32_t>) {
+    const __m256i lo = _mm256_set1_epi32(low), hi = _mm256_set1_epi32(high);
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lo, v), _mm256_cmpgt_epi32(v, hi));
+        const unsigned inside = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(outside))) & 0xFF;
+        mask |= static_cast<uint64_t>(inside) << i;
+    }
+    return i < count ? mask | columnMask(values + i, count - i, low, high, Portable<int32_t>()) << i : mask;
+}
+
+inline uint64_t columnMask(const float* values, size_t count, const float& low, const float& high,
+                           std::less<float>) {
+    const __m256 lo = _mm256_set1_ps(low), hi = _mm256_set1_ps(high);
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 v = _mm256_loadu_ps(values + i);
+        const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(v, lo, _CMP_NLT_UQ), _mm256_cmp_ps(v, hi, _CMP_NGT_UQ));
+        mask |= static_cast<uint64_t>(_mm256_movemask_ps(inside)) << i;
+    }
+    return i < count ? mask | columnMask(values + i, count - i, low, high, Portable<float>()) << i : mask;
+}
+
+inline uint64_t columnMask(const double* values, size_t count, const double& low, const double& high,
+                           std::less<double>) {
+    const __m256d lo = _mm256_set1_pd(low), hi = _mm256_set1_pd(high);
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d v = _mm256_loadu_pd(values + i);
+        const __m256d inside = _mm256_and_pd(_mm256_cmp_pd(v, lo, _CMP_NLT_UQ), _mm256_cmp_pd(v, hi, _CMP_NGT_UQ));
+        mask |= static_cast<uint64_t>(_mm256_movemask_pd(inside)) << i;
+    }
+    return i < count ? mask | columnMask(values + i, count - i, low, high, Portable<double>()) << i : mask;
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+// Lane bits are gathered by weighting each all-ones lane and summing across the vector
+inline uint64_t columnMask(const int32_t* values, size_t count, const int32_t& low, const int32_t& high,
+                           std::less<int32_t>) {
+    const int32x4_t lo = vdupq_n_s32(low), hi = vdupq_n_s32(high);
+    const uint32_t weights[4] = {1, 2, 4, 8};
+    const uint32x4_t weight = vld1q_u32(weights);
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const int32x4_t v = vld1q_s32(values + i);
+        const uint32x4_t inside = vandq_u32(vcgeq_s32(v, lo), vcleq_s32(v, hi));
+        mask |= static_cast<uint64_t>(vaddvq_u32(vandq_u32(inside, weight))) << i;
+    }
+    return i < count ? mask | columnMask(values + i, count - i, low, high, Portable<int32_t>()) << i : mask;
+}
+
+inline uint64_t columnMask(const float* values, size_t count, const float& low, const float& high,
+                           std::less<float>) {
+    const float32x4_t lo = vdupq_n_f32(low), hi = vdupq_n_f32(high);
+    const uint32_t weights[4] = {1, 2, 4, 8};
+    const uint32x4_t weight = vld1q_u32(weights);
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t v = vld1q_f32(values + i);
+        const uint32x4_t outside = vorrq_u32(vcltq_f32(v, lo), vcgtq_f32(v, hi));
+        mask |= static_cast<uint64_t>(vaddvq_u32(vbicq_u32(weight, outside))) << i;
+    }
+    return i < count ? mask | columnMask(values + i, count - i, low, high, Portable<float>()) << i : mask;
+}
+
+inline uint64_t columnMask(const double* values, size_t count, const double& low, const double& high,
+                           std::less<double>) {
+    const float64x2_t lo = vdupq_n_f64(low), hi = vdupq_n_f64(high);
+    const uint64_t weights[2] = {1, 2};
+    const uint64x2_t weight = vld1q_u64(weights);
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const float64x2_t v = vld1q_f64(values + i);
+        const uint64x2_t outside = vorrq_u64(vcltq_f64(v, lo), vcgtq_f64(v, hi));
+        mask |= vaddvq_u64(vbicq_u64(weight, outside)) << i;
+    }
+    return i < count ? mask | columnMask(values + i, count - i, low, high, Portable<double>()) << i : mask;
+}
+
+#endif
+
+// Bucket of count <= 64 positions starting at first, over the columns [from, to) of a
+// table whose column d holds column_size values at columns + d * column_size
+template<typename T, typename Compare = std::less<T>>
+uint64_t bucketMask(const T* columns, size_t column_size, size_t from, size_t to,
+                    size_t first, size_t count, const T* low, const T* high, Compare less = Compare()) {
+    uint64_t mask = lowBits(count);
+    for (size_t d = from; d < to && mask; ++d) {
+        mask &= columnMask(columns + d * column_size + first, count, low[d], high[d], less);
+    }
+    return mask;
+}
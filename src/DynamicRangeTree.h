@@ -0,0 +1,205 @@
+// DynamicRangeTree.h
+#pragma once
+
+#include "RangeTree.h"
+#include <vector>
+#include <array>
+#include <memory>
+#include <algorithm>
+
+// Range tree with insert and erase, by the logarithmic method (Bentley-Saxe):
+// points live in static RangeTrees whose sizes grow as powers of two, merged like
+// the digits of a binary counter, plus a small unsorted buffer for the newest ones.
+// Erased points are tombstoned and a level is rebuilt once half of it is dead.
+// Insert costs O(log^K n) amortized; queries visit O(log n) static trees.
+// Queries are const and may run concurrently, but not alongside insert or erase.
+template<typename T, size_t K>
+class DynamicRangeTree {
+public:
+    using Point = std::array<T, K>;
+    
+    explicit DynamicRangeTree(const BuildOptions& opts = BuildOptions(), size_t buffer_capacity = 64);
+    
+    void insert(const Point& point);
+    bool erase(const Point& point); // Removes one copy; false if the point is absent
+    
+    size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+    
+    std::vector<Point> rangeSearch(const Point& low, const Point& high) const;
+    size_t rangeCount(const Point& low, const Point& high) const;
+    bool search(const Point& point) const;
+    
+    // Streams every live hit to visit(point); the visitor returns false to stop
+    template<typename Visitor>
+    bool rangeSearch(const Point& low, const Point& high, Visitor&& visit) const;
+
+private:
+    // The tree is the only copy of a level's points; tombstones are by input index
+    struct Level {
+        std::vector<bool> dead;
+        size_t dead_count = 0;
+        std::unique_ptr<RangeTree<T, K>> tree; // Null while the level is empty
+    };
+    
+    std::vector<Point> buffer; // Newest points, scanned linearly
+    std::vector<Level> levels; // Level i holds at most buffer_capacity * 2^i points
+    BuildOptions options;
+    size_t buffer_capacity;
+    size_t live;
+    
+    // Helper methods
+    void flushBuffer();
+    void rebuild(Level& level, std::vector<Point> points);
+    static void appendLive(const Level& level, std::vector<Point>& points);
+    static bool isPointInRange(const Point& point, const Point& low, const Point& high);
+};
+
+template<typename T, size_t K>
+DynamicRangeTree<T, K>::DynamicRangeTree(const BuildOptions& opts, size_t capacity)
+    : options(opts), buffer_capacity(std::max<size_t>(capacity, 1)), live(0) {}
+
+template<typename T, size_t K>
+void DynamicRangeTree<T, K>::insert(const Point& point) {
+    buffer.push_back(point);
+    ++live;
+    if (buffer.size() >= buffer_capacity) flushBuffer();
+}
+
+template<typename T, size_t K>
+bool DynamicRangeTree<T, K>::erase(const Point& point) {
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        if (buffer[i] == point) {
+            buffer[i] = buffer.back();
+            buffer.pop_back();
+            --live;
+            return true;
+        }
+    }
+    
+    for (Level& level : levels) {
+        if (!level.tree) continue;
+        
+        // Tombstone the first live copy in this level
+        long found = -1;
+        level.tree->rangeSearch(point, point, [&level, &found](uint32_t index, const T*) {
+            if (level.dead[index]) return true;
+            found = index;
+            return false;
+        });
+        if (found < 0) continue;
+        
+        level.dead[found] = true;
+        ++level.dead_count;
+        --live;
+        if (2 * level.dead_count >= level.dead.size()) {
+            std::vector<Point> survivors;
+            appendLive(level, survivors);
+            rebuild(level, std::move(survivors));
+        }
+        return true;
+    }
+    return false;
+}
+
+template<typename T, size_t K>
+void DynamicRangeTree<T, K>::flushBuffer() {
+    // Carry the buffer up through the occupied levels into the first free one
+    std::vector<Point> carry;
+    carry.swap(buffer);
+    size_t i = 0;
+    for (; i < levels.size(); ++i) {
+        if (!levels[i].tree) break;
+        appendLive(levels[i], carry);
+        rebuild(levels[i], std::vector<Point>());
+    }
+    if (i == levels.size()) levels.emplace_back();
+    
+    // Shrunken by tombstones, the carry may settle below its nominal level
+    while (i > 0 && carry.size() <= (buffer_capacity << (i - 1))) --i;
+    rebuild(levels[i], std::move(carry));
+}
+
+template<typename T, size_t K>
+void DynamicRangeTree<T, K>::rebuild(Level& level, std::vector<Point> points) {
+    level.dead.assign(points.size(), false);
+    level.dead_count = 0;
+    level.tree.reset(points.empty() ? nullptr : new RangeTree<T, K>(std::move(points), options));
+}
+
+template<typename T, size_t K>
+void DynamicRangeTree<T, K>::appendLive(const Level& level, std::vector<Point>& points) {
+    for (size_t i = 0; i < level.dead.size(); ++i) {
+        if (!level.dead[i]) points.push_back(level.tree->point(static_cast<uint32_t>(i)));
+    }
+}
+
+template<typename T, size_t K>
+bool DynamicRangeTree<T, K>::isPointInRange(const Point& point, const Point& low, const Point& high) {
+    for (size_t i = 0; i < K; ++i) {
+        if (point[i] < low[i] || point[i] > high[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T, size_t K>
+template<typename Visitor>
+bool DynamicRangeTree<T, K>::rangeSearch(const Point& low, const Point& high, Visitor&& visit) const {
+    for (const Point& point : buffer) {
+        if (isPointInRange(point, low, high) && !visit(point)) return false;
+    }
+    
+    for (const Level& level : levels) {
+        if (!level.tree) continue;
+        bool complete = level.tree->rangeSearch(low, high, [&level, &visit](uint32_t index, const T* coords) {
+            if (level.dead[index]) return true;
+            Point point;
+            std::copy(coords, coords + K, point.begin());
+            return visit(point);
+        });
+        if (!complete) return false;
+    }
+    return true;
+}
+
+template<typename T, size_t K>
+std::vector<typename DynamicRangeTree<T, K>::Point> DynamicRangeTree<T, K>::rangeSearch(
+    const Point& low, const Point& high) const {
+    
+    std::vector<Point> result;
+    rangeSearch(low, high, [&result](const Point& point) {
+        result.push_back(point);
+        return true;
+    });
+    return result;
+}
+
+template<typename T, size_t K>
+size_t DynamicRangeTree<T, K>::rangeCount(const Point& low, const Point& high) const {
+    size_t count = 0;
+    for (const Point& point : buffer) {
+        if (isPointInRange(point, low, high)) ++count;
+    }
+    
+    // Levels without tombstones are counted without visiting their points
+    for (const Level& level : levels) {
+        if (!level.tree) continue;
+        if (level.dead_count == 0) {
+            count += level.tree->rangeCount(low, high);
+            continue;
+        }
+        level.tree->rangeSearch(low, high, [&level, &count](uint32_t index, const T*) {
+            if (!level.dead[index]) ++count;
+            return true;
+        });
+    }
+    return count;
+}
+
+template<typename T, size_t K>
+bool DynamicRangeTree<T, K>::search(const Point& point) const {
+    // Stops at the first live copy
+    return !rangeSearch(point, point, [](const Point&) { return false; });
+}
@@ -0,0 +1,595 @@
+// ExternalBuilder.h
+#pragma once
+
+#include "RangeTree.h"
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstdio>
+#include <type_traits>
+
+// Scratch file of fixed-size records, appended through a buffer and then read back by
+// SpillReader. The file is removed along with the object.
+template<typename Record>
+class SpillFile {
+public:
+    SpillFile(const std::string& file_path, size_t buffer_records)
+        : path(file_path), out(file_path, std::ios::binary | std::ios::trunc), count(0) {
+        if (!out) {
+            throw std::runtime_error("Cannot create spill file: " + path);
+        }
+        buffer.reserve(std::max<size_t>(buffer_records, 1));
+    }
+    ~SpillFile() {
+        out.close();
+        std::remove(path.c_str());
+    }
+    
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+    
+    void append(const Record& record) {
+        buffer.push_back(record);
+        ++count;
+        if (buffer.size() == buffer.capacity()) flush();
+    }
+    
+    // Ends writing; readers opened afterwards see every record
+    void finish() {
+        flush();
+        out.close();
+        std::vector<Record>().swap(buffer);
+    }
+    
+    size_t size() const { return count; }
+    const std::string& name() const { return path; }
+
+private:
+    std::string path;
+    std::ofstream out;
+    std::vector<Record> buffer;
+    size_t count;
+    
+    void flush() {
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(Record)));
+        if (!out) {
+            throw std::runtime_error("Cannot write spill file: " + path);
+        }
+        buffer.clear();
+    }
+};
+
+// Buffered reader of a finished spill file, sequential from any position. Seeking
+// within the buffered window costs nothing, so re-reading a short range is cheap.
+template<typename Record>
+class SpillReader {
+public:
+    SpillReader(const SpillFile<Record>& file, size_t buffer_records)
+        : in(file.name(), std::ios::binary), total(file.size()), buffer(std::max<size_t>(buffer_records, 1)),
+          first(0), filled(0), at(0) {
+        if (!in) {
+            throw std::runtime_error("Cannot open spill file: " + file.name());
+        }
+    }
+    
+    bool done() const { return at >= total; }
+    void seek(size_t position) { at = position; }
+    
+    const Record& next() {
+        if (at < first || at >= first + filled) fill();
+        return buffer[at++ - first];
+    }
+
+private:
+    std::ifstream in;
+    size_t total;
+    std::vector<Record> buffer;
+    size_t first, filled; // Window of the file held in buffer
+    size_t at;
+    
+    void fill() {
+        first = at;
+        filled = std::min(buffer.size(), total - at);
+        in.seekg(static_cast<std::streamoff>(at * sizeof(Record)));
+        in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(filled * sizeof(Record)));
+        if (!in) {
+            throw std::runtime_error("Cannot read spill file");
+        }
+    }
+};
+
+struct ExternalBuildOptions {
+    // Leaf bucket size of the built tree, as BuildOptions::leaf_size
+    size_t leaf_size = 32;
+    
+    // Bytes of points the sorts hold at once. The read and write buffers of the merges
+    // and level passes are carved from the same amount, so this bounds the build.
+    size_t memory_budget = size_t(256) << 20;
+    
+    // Directory of the spill files; empty places them next to the image
+    std::string temp_directory;
+};
+
+// Bulk loader writing the image of a RangeTree<T, K, Compare> straight to disk, for
+// point sets that do not fit in memory. The points are read once and sorted
+// externally, and each level array is written as it comes out of a sequential pass
+// over spill files, so the build stays within its budget whatever the input size.
+// RangeTree<T, K, Compare>::open() maps the result like any saved tree. The layout is
+// the one the in-memory build produces; fractional cascading is not available.
+template<typename T, size_t K, typename Compare = std::less<T>>
+class ExternalBuilder {
+public:
+    using Point = std::array<T, K>;
+    
+    explicit ExternalBuilder(const ExternalBuildOptions& opts = ExternalBuildOptions());
+    
+    // Points of an input range, read once
+    template<typename Iterator>
+    void build(Iterator first, Iterator last, const std::string& image_path);
+    
+    // Points stored back to back as raw Point values
+    void buildFromFile(const std::string& points_path, const std::string& image_path);
+
+private:
+    // A point on its way through the levels: its input position, its position in the
+    // level that spilled it, and the first position of the tree holding it there
+    struct Record {
+        uint32_t index;
+        uint32_t position;
+        uint32_t group;
+        Point coords;
+    };
+    using Spill = SpillFile<Record>;
+    
+    // Elements of one image array, written through a buffer
+    template<typename U>
+    class ArrayOut {
+    public:
+        ArrayOut(ImageWriter& writer, size_t count, size_t buffer_elements) : image(writer) {
+            image.beginArray(count);
+            values.reserve(std::max<size_t>(buffer_elements, 1));
+        }
+        void push(const U& value) {
+            values.push_back(value);
+            if (values.size() == values.capacity()) flush();
+        }
+        void flush() {
+            image.writeBytes(values.data(), values.size() * sizeof(U));
+            values.clear();
+        }
+    
+    private:
+        ImageWriter& image;
+        std::vector<U> values;
+    };
+    
+    ExternalBuildOptions options;
+    size_t chunk; // Records sorted in memory at once
+    size_t buffer; // Records per read or write buffer
+    size_t fan_in; // Runs merged at once
+    std::string spill_prefix;
+    size_t spills;
+    
+    // Helper methods
+    template<typename Next>
+    void buildFrom(Next next, const std::string& image_path);
+    template<typename U>
+    std::unique_ptr<SpillFile<U>> newSpill(size_t buffer_records = 0) {
+        return std::unique_ptr<SpillFile<U>>(
+            new SpillFile<U>(spill_prefix + std::to_string(spills++), buffer_records ? buffer_records : buffer));
+    }
+    
+    static bool recordBefore(const Record& a, const Record& b, size_t axis);
+    template<typename Produce>
+    std::unique_ptr<Spill> sortRecords(Produce produce, size_t axis);
+    std::unique_ptr<Spill> mergeRuns(std::vector<std::unique_ptr<Spill>>& runs, size_t first, size_t last, size_t axis);
+    
+    template<size_t Level>
+    void buildLevel(std::integral_constant<size_t, Level>, const Spill& records, uint32_t depth, ImageWriter& image);
+    void buildLevel(std::integral_constant<size_t, K - 1>, const Spill& records, uint32_t depth, ImageWriter& image);
+    
+    void writeOrder(const Spill& records, ImageWriter& image) const;
+    void writeKeys(const Spill& records, size_t axis, uint32_t depth, ImageWriter& image);
+    void writeColumns(const Spill& records, size_t axis, size_t dims, ImageWriter& image) const;
+    size_t searchedDepths(uint32_t count, uint32_t depth) const;
+    std::unique_ptr<Spill> spillNextAxis(const Spill& records, size_t axis, uint32_t depth);
+    std::unique_ptr<Spill> splitDepth(const Spill& lists, uint32_t depth);
+    
+    // Visits the nonempty nodes at depth below node, left to right
+    template<typename Visit>
+    static void forNodesAtDepth(const TreeCursor& node, uint32_t depth, Visit& visit) {
+        if (node.empty()) return;
+        if (node.depth == depth) {
+            visit(node);
+            return;
+        }
+        forNodesAtDepth(node.left(), depth, visit);
+        forNodesAtDepth(node.right(), depth, visit);
+    }
+    
+    // Visits the nodes below node in key order, i.e. by ascending position
+    template<typename Visit>
+    static void forNodesInOrder(const TreeCursor& node, Visit& visit) {
+        if (node.empty()) return;
+        forNodesInOrder(node.left(), visit);
+        visit(node);
+        forNodesInOrder(node.right(), visit);
+    }
+};
+
+template<typename T, size_t K, typename Compare>
+ExternalBuilder<T, K, Compare>::ExternalBuilder(const ExternalBuildOptions& opts) : options(opts), spills(0) {
+    static_assert(std::is_trivially_copyable<T>::value, "Spill files store coordinates as raw bytes");
+    chunk = std::max<size_t>(options.memory_budget / sizeof(Record), 64);
+    buffer = std::max<size_t>(chunk / 16, 64);
+    fan_in = std::max<size_t>(chunk / buffer, 2);
+}
+
+template<typename T, size_t K, typename Compare>
+template<typename Iterator>
+void ExternalBuilder<T, K, Compare>::build(Iterator first, Iterator last, const std::string& image_path) {
+    buildFrom([&first, &last](Point& point) {
+        if (first == last) return false;
+        point = *first;
+        ++first;
+        return true;
+    }, image_path);
+}
+
+template<typename T, size_t K, typename Compare>
+void ExternalBuilder<T, K, Compare>::buildFromFile(const std::string& points_path, const std::string& image_path) {
+    std::ifstream in(points_path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Cannot open point file: " + points_path);
+    }
+    const size_t bytes = static_cast<size_t>(in.tellg());
+    if (bytes % sizeof(Point) != 0) {
+        throw std::runtime_error("Point file does not hold whole points: " + points_path);
+    }
+    in.seekg(0);
+    
+    size_t remaining = bytes / sizeof(Point);
+    std::vector<Point> block(buffer);
+    size_t filled = 0, at = 0;
+    buildFrom([&](Point& point) {
+        if (at == filled) {
+            if (remaining == 0) return false;
+            filled = std::min(block.size(), remaining);
+            in.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(filled * sizeof(Point)));
+            if (!in) {
+                throw std::runtime_error("Cannot read point file: " + points_path);
+            }
+            remaining -= filled;
+            at = 0;
+        }
+        point = block[at++];
+        return true;
+    }, image_path);
+}
+
+template<typename T, size_t K, typename Compare>
+template<typename Next>
+void ExternalBuilder<T, K, Compare>::buildFrom(Next next, const std::string& image_path) {
+    const std::string name = image_path.substr(image_path.find_last_of('/') + 1);
+    spill_prefix = (options.temp_directory.empty() ? image_path : options.temp_directory + "/" + name) + ".spill";
+    
+    // One pass over the input spills each coordinate column and sorts the points along the first axis
+    std::vector<std::unique_ptr<SpillFile<T>>> columns;
+    for (size_t d = 0; d < K; ++d) {
+        columns.push_back(newSpill<T>());
+    }
+    size_t count = 0;
+    Point point;
+    std::unique_ptr<Spill> sorted = sortRecords([&](Record& record) {
+        if (!next(point)) return false;
+        if (count >= std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("Too many points for 32-bit point indices");
+        }
+        record.index = static_cast<uint32_t>(count++);
+        record.position = 0;
+        record.group = 0;
+        record.coords = point;
+        for (size_t d = 0; d < K; ++d) {
+            columns[d]->append(point[d]);
+        }
+        return true;
+    }, 0);
+    
+    // The header as RangeTree::save writes it, then the columns one after another
+    ImageWriter image(image_path);
+    BuildOptions layout;
+    if (K > 1) layout.leaf_size = options.leaf_size;
+    writeImageFields<T>(image, K, 0, layout, K);
+    ArrayOut<T> coords(image, count * K, buffer);
+    for (auto& column : columns) {
+        column->finish();
+        SpillReader<T> reader(*column, buffer);
+        while (!reader.done()) coords.push(reader.next());
+        column.reset();
+    }
+    coords.flush();
+    image.writeArray<uint32_t>(nullptr, 0); // Every point has all K coordinates
+    
+    buildLevel(std::integral_constant<size_t, 0>(), *sorted, 0, image);
+}
+
+template<typename T, size_t K, typename Compare>
+bool ExternalBuilder<T, K, Compare>::recordBefore(const Record& a, const Record& b, size_t axis) {
+    if (a.group != b.group) return a.group < b.group;
+    if (Compare()(a.coords[axis], b.coords[axis])) return true;
+    if (Compare()(b.coords[axis], a.coords[axis])) return false;
+    return a.index < b.index;
+}
+
+// Sorts the produced records by group, then along axis: runs of one chunk each are
+// sorted in memory and spilled, then merged fan_in at a time until one is left
+template<typename T, size_t K, typename Compare>
+template<typename Produce>
+std::unique_ptr<typename ExternalBuilder<T, K, Compare>::Spill>
+ExternalBuilder<T, K, Compare>::sortRecords(Produce produce, size_t axis) {
+    std::vector<std::unique_ptr<Spill>> runs;
+    std::vector<Record> records;
+    records.reserve(chunk);
+    Record record;
+    bool more = true;
+    while (more) {
+        records.clear();
+        while (records.size() < chunk && (more = produce(record))) {
+            records.push_back(record);
+        }
+        if (records.empty()) break;
+        
+        std::sort(records.begin(), records.end(), [axis](const Record& a, const Record& b) {
+            return recordBefore(a, b, axis);
+        });
+        runs.push_back(newSpill<Record>());
+        for (const Record& sorted : records) runs.back()->append(sorted);
+        runs.back()->finish();
+    }
+    std::vector<Record>().swap(records);
+    
+    if (runs.empty()) {
+        runs.push_back(newSpill<Record>());
+        runs.back()->finish();
+    }
+    while (runs.size() > 1) {
+        std::vector<std::unique_ptr<Spill>> merged;
+        for (size_t first = 0; first < runs.size(); first += fan_in) {
+            const size_t last = std::min(runs.size(), first + fan_in);
+            merged.push_back(last - first == 1 ? std::move(runs[first]) : mergeRuns(runs, first, last, axis));
+        }
+        runs = std::move(merged);
+    }
+    return std::move(runs.front());
+}
+
+template<typename T, size_t K, typename Compare>
+std::unique_ptr<typename ExternalBuilder<T, K, Compare>::Spill>
+ExternalBuilder<T, K, Compare>::mergeRuns(std::vector<std::unique_ptr<Spill>>& runs, size_t first, size_t last,
+                                          size_t axis) {
+    std::vector<std::unique_ptr<SpillReader<Record>>> readers;
+    std::vector<Record> heads(last - first);
+    std::vector<size_t> heap;
+    for (size_t run = first; run < last; ++run) {
+        readers.emplace_back(new SpillReader<Record>(*runs[run], buffer));
+        if (!readers.back()->done()) {
+            heads[run - first] = readers.back()->next();
+            heap.push_back(run - first);
+        }
+    }
+    
+    // Smallest head on top
+    auto after = [&heads, axis](size_t a, size_t b) { return recordBefore(heads[b], heads[a], axis); };
+    std::make_heap(heap.begin(), heap.end(), after);
+    std::unique_ptr<Spill> merged = newSpill<Record>();
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        const size_t run = heap.back();
+        merged->append(heads[run]);
+        if (readers[run]->done()) {
+            heap.pop_back();
+        } else {
+            heads[run] = readers[run]->next();
+            std::push_heap(heap.begin(), heap.end(), after);
+        }
+    }
+    merged->finish();
+    
+    readers.clear();
+    for (size_t run = first; run < last; ++run) runs[run].reset();
+    return merged;
+}
+
+// One forest level, in the order saveLevel writes it. The forest holds the subtrees at
+// depth of the tree over all positions; records lists the level's points in its order.
+template<typename T, size_t K, typename Compare>
+template<size_t Level>
+void ExternalBuilder<T, K, Compare>::buildLevel(std::integral_constant<size_t, Level>, const Spill& records,
+                                                uint32_t depth, ImageWriter& image) {
+    const uint32_t count = static_cast<uint32_t>(records.size());
+    writeOrder(records, image);
+    writeKeys(records, Level, depth, image);
+    writeColumns(records, Level, count > 0 && options.leaf_size > 0 ? K - Level : 0, image);
+    image.writeValue(0); // No cascade
+    
+    const size_t searched = count > 0 ? searchedDepths(count, depth) : 0;
+    image.writeValue(searched);
+    if (searched == 0) return;
+    
+    // Each depth's associated forest, the next one split out of the lists of this one
+    std::unique_ptr<Spill> lists = spillNextAxis(records, Level, depth);
+    for (size_t below = 0; below < searched; ++below) {
+        const uint32_t at = depth + static_cast<uint32_t>(below);
+        buildLevel(std::integral_constant<size_t, Level + 1>(), *lists, at, image);
+        if (below + 1 < searched) lists = splitDepth(*lists, at);
+    }
+}
+
+template<typename T, size_t K, typename Compare>
+void ExternalBuilder<T, K, Compare>::buildLevel(std::integral_constant<size_t, K - 1>, const Spill& records,
+                                                uint32_t depth, ImageWriter& image) {
+    writeOrder(records, image);
+    writeKeys(records, K - 1, depth, image);
+}
+
+template<typename T, size_t K, typename Compare>
+void ExternalBuilder<T, K, Compare>::writeOrder(const Spill& records, ImageWriter& image) const {
+    ArrayOut<uint32_t> order(image, records.size(), buffer);
+    SpillReader<Record> reader(records, buffer);
+    while (!reader.done()) order.push(reader.next().index);
+    order.flush();
+}
+
+// Keys of every tree of the forest in BFS order, as fillKeys lays them out. Trees that
+// fit in a chunk are laid out in memory. Larger ones are read once in key order, each
+// key spilled to the file of its depth, and the depth files are then appended in turn.
+template<typename T, size_t K, typename Compare>
+void ExternalBuilder<T, K, Compare>::writeKeys(const Spill& records, size_t axis, uint32_t depth,
+                                               ImageWriter& image) {
+    const uint32_t count = static_cast<uint32_t>(records.size());
+    ArrayOut<T> keys(image, count, buffer);
+    SpillReader<Record> reader(records, buffer);
+    std::vector<T> loaded, values;
+    uint32_t written = 0;
+    
+    auto tree = [&](const TreeCursor& node) {
+        for (; written < node.begin; ++written) keys.push(T()); // Outside every tree
+        const TreeCursor root = TreeCursor::root(node.begin, node.end);
+        if (node.end - node.begin <= chunk) {
+            loaded.clear();
+            reader.seek(node.begin);
+            for (uint32_t i = node.begin; i < node.end; ++i) loaded.push_back(reader.next().coords[axis]);
+            values.assign(loaded.size(), T());
+            std::vector<TreeCursor> pending(1, root);
+            while (!pending.empty()) {
+                const TreeCursor at = pending.back();
+                pending.pop_back();
+                if (at.empty()) continue;
+                values[at.index] = loaded[at.mid - node.begin];
+                pending.push_back(at.left());
+                pending.push_back(at.right());
+            }
+            for (const T& value : values) keys.push(value);
+        } else {
+            // The in-order walk meets the positions one after another, and the nodes of
+            // each depth left to right, i.e. in their BFS order. The leftmost path is the
+            // longest, and the depth files share one read buffer's worth of memory.
+            size_t height = 0;
+            for (TreeCursor at = root; !at.empty(); at = at.left()) ++height;
+            const size_t level_buffer = std::max<size_t>(buffer * sizeof(Record) / sizeof(T) / height, 64);
+            std::vector<std::unique_ptr<SpillFile<T>>> levels;
+            for (size_t level = 0; level < height; ++level) {
+                levels.push_back(newSpill<T>(level_buffer));
+            }
+            
+            reader.seek(node.begin);
+            auto key = [&](const TreeCursor& at) { levels[at.depth]->append(reader.next().coords[axis]); };
+            forNodesInOrder(root, key);
+            for (auto& level : levels) {
+                level->finish();
+                SpillReader<T> level_keys(*level, buffer);
+                while (!level_keys.done()) keys.push(level_keys.next());
+                level.reset();
+            }
+        }
+        written = node.end;
+    };
+    forNodesAtDepth(TreeCursor::root(0, count), depth, tree);
+    for (; written < count; ++written) keys.push(T());
+    keys.flush();
+}
+
+template<typename T, size_t K, typename Compare>
+void ExternalBuilder<T, K, Compare>::writeColumns(const Spill& records, size_t axis, size_t dims,
+                                                  ImageWriter& image) const {
+    ArrayOut<T> columns(image, dims * records.size(), buffer);
+    for (size_t d = 0; d < dims; ++d) {
+        SpillReader<Record> reader(records, buffer);
+        while (!reader.done()) columns.push(reader.next().coords[axis + d]);
+    }
+    columns.flush();
+}
+
+// Depths from depth on holding a subtree larger than a bucket; the deeper ones are never
+// searched and get no associated forest
+template<typename T, size_t K, typename Compare>
+size_t ExternalBuilder<T, K, Compare>::searchedDepths(uint32_t count, uint32_t depth) const {
+    // The leftmost subtree of a depth is its largest
+    size_t searched = 0;
+    uint32_t size = count;
+    for (uint32_t at = 0; size > 0; ++at) {
+        if (at >= depth && size > options.leaf_size) ++searched;
+        size = static_cast<uint32_t>(leftSubtreeSize(size));
+    }
+    return searched;
+}
+
+// The lists of the first associated forest: the points of each tree sorted along the
+// next axis in place of the tree, tagged with their position in this level. Positions
+// outside every tree keep their own point.
+template<typename T, size_t K, typename Compare>
+std::unique_ptr<typename ExternalBuilder<T, K, Compare>::Spill>
+ExternalBuilder<T, K, Compare>::spillNextAxis(const Spill& records, size_t axis, uint32_t depth) {
+    const uint32_t count = static_cast<uint32_t>(records.size());
+    SpillReader<Record> reader(records, buffer);
+    uint32_t position = 0;
+    TreeCursor tree = TreeCursor::root(0, 0);
+    return sortRecords([&](Record& record) {
+        if (reader.done()) return false;
+        record = reader.next();
+        record.position = position;
+        
+        // Positions run in order, so the tree of the previous one usually holds this one too
+        if (tree.depth != depth || position < tree.begin || position >= tree.end) {
+            tree = TreeCursor::root(0, count);
+            while (tree.depth < depth && position != tree.mid) {
+                tree = position < tree.mid ? tree.left() : tree.right();
+            }
+        }
+        record.group = tree.depth == depth ? tree.begin : position;
+        ++position;
+        return true;
+    }, axis + 1);
+}
+
+// The next depth's lists: each node's list split stably around the node, as
+// buildForest does it, in two sequential passes over the node's range
+template<typename T, size_t K, typename Compare>
+std::unique_ptr<typename ExternalBuilder<T, K, Compare>::Spill>
+ExternalBuilder<T, K, Compare>::splitDepth(const Spill& lists, uint32_t depth) {
+    const uint32_t count = static_cast<uint32_t>(lists.size());
+    SpillReader<Record> reader(lists, buffer);
+    std::unique_ptr<Spill> split = newSpill<Record>();
+    uint32_t copied = 0;
+    
+    auto node = [&](const TreeCursor& at) {
+        reader.seek(copied);
+        for (; copied < at.begin; ++copied) split->append(reader.next());
+        
+        Record middle = Record();
+        reader.seek(at.begin);
+        for (uint32_t i = at.begin; i < at.end; ++i) {
+            const Record& record = reader.next();
+            if (record.position < at.mid) split->append(record);
+            if (record.position == at.mid) middle = record;
+        }
+        split->append(middle);
+        reader.seek(at.begin);
+        for (uint32_t i = at.begin; i < at.end; ++i) {
+            const Record& record = reader.next();
+            if (record.position > at.mid) split->append(record);
+        }
+        copied = at.end;
+    };
+    forNodesAtDepth(TreeCursor::root(0, count), depth, node);
+    reader.seek(copied);
+    for (; copied < count; ++copied) split->append(reader.next());
+    split->finish();
+    return split;
+}
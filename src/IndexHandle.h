@@ -0,0 +1,190 @@
+// IndexHandle.h
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+// Current version of an index, replaced while queries keep reading. Readers take a
+// Snapshot without locking: they announce the epoch they start in, then load the
+// published pointer. publish() swaps the pointer atomically and retires the old
+// version under the epoch it was current in; a retired version is freed once every
+// announced reader started after it was replaced, so nobody sees a freed or
+// half-built index. Readers never wait on publish or each other, unless more of them
+// are inside a snapshot at once than the handle has reader slots.
+template<typename Index>
+class IndexHandle {
+public:
+    class Snapshot;
+    
+    // reader_slots bounds the readers inside a snapshot at once; 0 takes four per hardware
+    // thread, at least 64. When every slot is claimed, read() spins until one is released.
+    explicit IndexHandle(std::unique_ptr<Index> initial, unsigned reader_slots = 0);
+    ~IndexHandle(); // No snapshot may outlive the handle
+    
+    IndexHandle(const IndexHandle&) = delete;
+    IndexHandle& operator=(const IndexHandle&) = delete;
+    
+    // The published version, pinned until the snapshot is dropped
+    Snapshot read() const;
+    
+    // Runs query on the published version, e.g. handle.with([&](const Tree& t) { return t.rangeCount(lo, hi); })
+    template<typename Query>
+    auto with(Query query) const -> decltype(query(std::declval<const Index&>())) {
+        Snapshot snapshot = read();
+        return query(*snapshot);
+    }
+    
+    // Makes next the published version and frees what no reader can still see.
+    // Publishers are serialized among themselves only.
+    void publish(std::unique_ptr<Index> next);
+    
+    // Frees the retired versions no reader can still see; returns how many it freed.
+    // publish() does this too, so a version outliving its last reader waits for the
+    // next publish or reclaim.
+    size_t reclaim();
+    
+    size_t retiredCount() const;
+    uint64_t version() const { return epoch.load(); } // Number of publishes so far
+
+private:
+    static const uint64_t idle = std::numeric_limits<uint64_t>::max();
+    
+    // Epoch a reader started in, or idle; one cache line each so readers do not contend
+    struct Slot {
+        std::atomic<uint64_t> epoch;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    
+    struct Retired {
+        std::unique_ptr<Index> index;
+        uint64_t epoch; // Last epoch it was published in
+    };
+    
+    std::atomic<Index*> current;
+    std::atomic<uint64_t> epoch;
+    std::unique_ptr<Slot[]> slots;
+    size_t slot_count;
+    
+    mutable std::mutex publish_mutex;
+    std::deque<Retired> retired; // Oldest first
+    
+    // Helper methods
+    size_t reclaimLocked();
+};
+
+// Pins one version of the index for as long as it lives
+template<typename Index>
+class IndexHandle<Index>::Snapshot {
+public:
+    Snapshot(Snapshot&& other) noexcept : slot(other.slot), index(other.index) {
+        other.slot = nullptr;
+        other.index = nullptr;
+    }
+    Snapshot& operator=(Snapshot&& other) noexcept {
+        release();
+        slot = other.slot;
+        index = other.index;
+        other.slot = nullptr;
+        other.index = nullptr;
+        return *this;
+    }
+    ~Snapshot() { release(); }
+    
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    
+    const Index& operator*() const { return *index; }
+    const Index* operator->() const { return index; }
+    const Index* get() const { return index; }
+    explicit operator bool() const { return index != nullptr; }
+
+private:
+    friend class IndexHandle;
+    
+    Slot* slot;
+    const Index* index;
+    
+    Snapshot(Slot* s, const Index* i) : slot(s), index(i) {}
+    
+    // Release, so every read of the index happens before a publisher sees the slot idle
+    void release() {
+        if (slot) slot->epoch.store(idle, std::memory_order_release);
+        slot = nullptr;
+        index = nullptr;
+    }
+};
+
+template<typename Index>
+IndexHandle<Index>::IndexHandle(std::unique_ptr<Index> initial, unsigned reader_slots)
+    : current(initial.release()), epoch(0) {
+    slot_count = reader_slots ? reader_slots : std::max(4 * std::thread::hardware_concurrency(), 64u);
+    slots.reset(new Slot[slot_count]);
+    for (size_t i = 0; i < slot_count; ++i) {
+        slots[i].epoch.store(idle, std::memory_order_relaxed);
+    }
+}
+
+template<typename Index>
+IndexHandle<Index>::~IndexHandle() {
+    delete current.load();
+}
+
+template<typename Index>
+typename IndexHandle<Index>::Snapshot IndexHandle<Index>::read() const {
+    // Claim an idle slot with the epoch we start in, from a per-thread starting point.
+    // The claim is ordered before the pointer load, so a publisher that finds the
+    // slot idle has swapped the pointer before we load it.
+    size_t at = std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count;
+    for (;;) {
+        uint64_t expected = idle;
+        const uint64_t started = epoch.load();
+        if (slots[at].epoch.compare_exchange_strong(expected, started)) {
+            return Snapshot(&slots[at], current.load());
+        }
+        at = at + 1 == slot_count ? 0 : at + 1;
+    }
+}
+
+template<typename Index>
+void IndexHandle<Index>::publish(std::unique_ptr<Index> next) {
+    std::lock_guard<std::mutex> lock(publish_mutex);
+    Index* replaced = current.exchange(next.release());
+    // Readers holding the replaced version read an epoch no later than this one
+    retired.push_back(Retired{std::unique_ptr<Index>(replaced), epoch.fetch_add(1)});
+    reclaimLocked();
+}
+
+template<typename Index>
+size_t IndexHandle<Index>::reclaim() {
+    std::lock_guard<std::mutex> lock(publish_mutex);
+    return reclaimLocked();
+}
+
+template<typename Index>
+size_t IndexHandle<Index>::reclaimLocked() {
+    uint64_t oldest = idle;
+    for (size_t i = 0; i < slot_count; ++i) {
+        oldest = std::min(oldest, slots[i].epoch.load());
+    }
+    
+    size_t freed = 0;
+    while (!retired.empty() && retired.front().epoch < oldest) {
+        retired.pop_front();
+        ++freed;
+    }
+    return freed;
+}
+
+template<typename Index>
+size_t IndexHandle<Index>::retiredCount() const {
+    std::lock_guard<std::mutex> lock(publish_mutex);
+    return retired.size();
+}
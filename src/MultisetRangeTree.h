@@ -0,0 +1,154 @@
+// MultisetRangeTree.h
+#pragma once
+
+#include "AggregateRangeTree.h"
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+// Range tree over a multiset of points: coincident points are stored once, with the
+// input positions of all their copies. The tree and every associated structure only
+// hold the distinct points, and each carries its multiplicity in a sum segment tree,
+// so rangeCount still counts every copy without enumerating the box.
+template<typename T, size_t K, typename Compare = std::less<T>>
+class MultisetRangeTree {
+public:
+    using Point = std::array<T, K>;
+    
+    // The copies of one distinct point: input positions [first, last), ascending
+    struct Group {
+        const Point* point;
+        const uint32_t* first;
+        const uint32_t* last;
+        
+        size_t count() const { return last - first; }
+    };
+    
+    MultisetRangeTree(const std::vector<Point>& points, const BuildOptions& opts = BuildOptions());
+    
+    size_t size() const { return members.size(); }
+    size_t distinctSize() const { return distinct.size(); }
+    
+    // Every copy in the box, as a RangeTree over all the points reports them
+    std::vector<Point> rangeSearch(const Point& low, const Point& high) const;
+    std::vector<uint32_t> rangeSearchIndices(const Point& low, const Point& high) const;
+    size_t rangeCount(const Point& low, const Point& high) const;
+    size_t rangeCount(const QueryBox<T, K>& box) const;
+    bool search(const Point& point) const;
+    
+    // One entry per distinct point in the box, in lexicographic order of the points
+    std::vector<Group> rangeSearchGroups(const Point& low, const Point& high) const;
+    size_t distinctCount(const Point& low, const Point& high) const;
+    
+    // The tree over the distinct points, with their multiplicities as values
+    const AggregateRangeTree<T, K, size_t, SumOf<size_t>, Compare>& countTree() const { return tree; }
+
+private:
+    // The input grouped by point, before the tree is built over the distinct points
+    struct Grouping {
+        std::vector<Point> distinct;
+        std::vector<uint32_t> members;
+        std::vector<uint32_t> starts;
+        std::vector<size_t> counts;
+    };
+    
+    std::vector<Point> distinct; // Indexed by group
+    std::vector<uint32_t> members; // Input positions grouped by point; group g is [starts[g], starts[g + 1])
+    std::vector<uint32_t> starts;
+    AggregateRangeTree<T, K, size_t, SumOf<size_t>, Compare> tree; // Over distinct, so declared after it
+    
+    // Helper methods
+    static bool less(const Point& a, const Point& b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), Compare());
+    }
+    static Grouping groupPoints(const std::vector<Point>& points);
+    MultisetRangeTree(Grouping grouping, const BuildOptions& opts);
+    Group group(uint32_t id) const {
+        return Group{&distinct[id], members.data() + starts[id], members.data() + starts[id + 1]};
+    }
+};
+
+template<typename T, size_t K, typename Compare>
+MultisetRangeTree<T, K, Compare>::MultisetRangeTree(const std::vector<Point>& points, const BuildOptions& opts)
+    : MultisetRangeTree(groupPoints(points), opts) {}
+
+template<typename T, size_t K, typename Compare>
+MultisetRangeTree<T, K, Compare>::MultisetRangeTree(Grouping grouping, const BuildOptions& opts)
+    : distinct(std::move(grouping.distinct)), members(std::move(grouping.members)),
+      starts(std::move(grouping.starts)), tree(distinct, std::move(grouping.counts), opts) {}
+
+// Sorts the input positions by point and cuts them into one group per distinct point
+template<typename T, size_t K, typename Compare>
+typename MultisetRangeTree<T, K, Compare>::Grouping
+MultisetRangeTree<T, K, Compare>::groupPoints(const std::vector<Point>& points) {
+    Grouping grouping;
+    std::vector<uint32_t>& members = grouping.members;
+    members = pointIndices(points.size());
+    std::sort(members.begin(), members.end(), [&points](uint32_t a, uint32_t b) {
+        return less(points[a], points[b]) || (!less(points[b], points[a]) && a < b);
+    });
+    
+    for (size_t i = 0; i < members.size(); ++i) {
+        const Point& point = points[members[i]];
+        if (grouping.distinct.empty() || less(grouping.distinct.back(), point)) {
+            grouping.distinct.push_back(point);
+            grouping.starts.push_back(static_cast<uint32_t>(i));
+            grouping.counts.push_back(0);
+        }
+        ++grouping.counts.back();
+    }
+    grouping.starts.push_back(static_cast<uint32_t>(members.size()));
+    return grouping;
+}
+
+template<typename T, size_t K, typename Compare>
+std::vector<typename MultisetRangeTree<T, K, Compare>::Point>
+MultisetRangeTree<T, K, Compare>::rangeSearch(const Point& low, const Point& high) const {
+    std::vector<Point> result;
+    for (uint32_t id : tree.rangeTree().rangeSearchIndices(low, high)) {
+        result.insert(result.end(), starts[id + 1] - starts[id], distinct[id]);
+    }
+    return result;
+}
+
+template<typename T, size_t K, typename Compare>
+std::vector<uint32_t> MultisetRangeTree<T, K, Compare>::rangeSearchIndices(const Point& low, const Point& high) const {
+    std::vector<uint32_t> indices;
+    for (uint32_t id : tree.rangeTree().rangeSearchIndices(low, high)) {
+        indices.insert(indices.end(), members.begin() + starts[id], members.begin() + starts[id + 1]);
+    }
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template<typename T, size_t K, typename Compare>
+size_t MultisetRangeTree<T, K, Compare>::rangeCount(const Point& low, const Point& high) const {
+    return tree.rangeAggregate(low, high);
+}
+
+template<typename T, size_t K, typename Compare>
+size_t MultisetRangeTree<T, K, Compare>::rangeCount(const QueryBox<T, K>& box) const {
+    return tree.rangeAggregate(box);
+}
+
+template<typename T, size_t K, typename Compare>
+bool MultisetRangeTree<T, K, Compare>::search(const Point& point) const {
+    return tree.rangeTree().search(point);
+}
+
+template<typename T, size_t K, typename Compare>
+std::vector<typename MultisetRangeTree<T, K, Compare>::Group>
+MultisetRangeTree<T, K, Compare>::rangeSearchGroups(const Point& low, const Point& high) const {
+    std::vector<Group> groups;
+    for (uint32_t id : tree.rangeTree().rangeSearchIndices(low, high)) {
+        groups.push_back(group(id));
+    }
+    return groups;
+}
+
+template<typename T, size_t K, typename Compare>
+size_t MultisetRangeTree<T, K, Compare>::distinctCount(const Point& low, const Point& high) const {
+    return tree.rangeTree().rangeCount(low, high);
+}
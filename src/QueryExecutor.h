@@ -0,0 +1,255 @@
+// QueryExecutor.h
+#pragma once
+
+#include "RangeTree.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <numeric>
+
+// Fixed set of threads running one parallel loop at a time. The loop is cut into
+// chunks dealt round-robin to per-thread queues; a thread works from the back of
+// its own queue and steals from the front of the others' once it runs dry.
+class WorkStealingPool {
+public:
+    // Body of a loop: (thread id, first item, one past the last item)
+    using Body = std::function<void(unsigned, size_t, size_t)>;
+    
+    // threads counts the calling thread, which takes part in every loop; 0 uses all hardware threads
+    explicit WorkStealingPool(unsigned threads = 0);
+    ~WorkStealingPool();
+    
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+    
+    // Runs body over [0, count) in chunks of grain items and returns once all are done.
+    // The first exception thrown by a chunk is rethrown here after the others finish.
+    void parallelFor(size_t count, size_t grain, const Body& body);
+
+private:
+    struct Chunk {
+        size_t first, last;
+    };
+    
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+    
+    std::vector<std::unique_ptr<Queue>> queues; // The caller's queue comes last
+    std::vector<std::thread> workers;
+    
+    std::mutex run_mutex; // One loop at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const Body* body;
+    std::atomic<size_t> pending; // Chunks not finished yet
+    unsigned long generation; // Bumped for every loop to wake the workers
+    bool stopping;
+    std::exception_ptr error;
+    
+    // Helper methods
+    void workerLoop(unsigned id);
+    bool takeChunk(unsigned id, Chunk& chunk);
+    void runChunk(unsigned id, const Chunk& chunk);
+};
+
+inline WorkStealingPool::WorkStealingPool(unsigned threads)
+    : body(nullptr), pending(0), generation(0), stopping(false) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    
+    for (unsigned i = 0; i < threads; ++i) {
+        queues.emplace_back(new Queue());
+    }
+    for (unsigned i = 0; i + 1 < threads; ++i) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+inline WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+inline void WorkStealingPool::parallelFor(size_t count, size_t grain, const Body& loop) {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+    
+    std::lock_guard<std::mutex> run(run_mutex);
+    const unsigned caller = size() - 1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        body = &loop;
+        error = nullptr;
+        pending = (count + grain - 1) / grain;
+    }
+    
+    size_t next = 0;
+    for (size_t first = 0; first < count; first += grain, ++next) {
+        Queue& queue = *queues[next % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.chunks.push_back({first, std::min(count, first + grain)});
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+    }
+    wake.notify_all();
+    
+    // The caller works like any other thread, then waits for the stragglers
+    Chunk chunk;
+    while (takeChunk(caller, chunk)) {
+        runChunk(caller, chunk);
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return pending == 0; });
+    body = nullptr;
+    if (error) {
+        std::exception_ptr failure = error;
+        error = nullptr;
+        std::rethrow_exception(failure);
+    }
+}
+
+inline void WorkStealingPool::workerLoop(unsigned id) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        
+        Chunk chunk;
+        while (takeChunk(id, chunk)) {
+            runChunk(id, chunk);
+        }
+    }
+}
+
+inline bool WorkStealingPool::takeChunk(unsigned id, Chunk& chunk) {
+    // Own queue first, newest chunk first
+    {
+        Queue& own = *queues[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+    
+    // Then steal the oldest chunk of the next thread that has one
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        Queue& victim = *queues[(id + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void WorkStealingPool::runChunk(unsigned id, const Chunk& chunk) {
+    // The body was published before the chunk was queued
+    try {
+        (*body)(id, chunk.first, chunk.last);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+    }
+    
+    if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+    }
+}
+
+// Runs batches of independent queries over one shared, read-only tree. Every
+// thread appends the hits of its queries to an arena of its own, kept across
+// batches, and the arenas are merged into a single BatchResult at the end.
+class QueryExecutor {
+public:
+    explicit QueryExecutor(unsigned threads = 0, size_t grain = 64)
+        : pool(threads), grain(grain), arenas(pool.size()) {}
+    
+    // Same results as tree.rangeSearchBatch(boxes), hits of a query in traversal order
+    template<typename Tree>
+    BatchResult rangeSearch(const Tree& tree, const std::vector<typename Tree::Box>& boxes);
+    
+    template<typename Tree>
+    std::vector<size_t> rangeCount(const Tree& tree, const std::vector<typename Tree::Box>& boxes);
+    
+    unsigned threads() const { return pool.size(); }
+
+private:
+    WorkStealingPool pool;
+    size_t grain; // Queries per chunk
+    std::vector<std::vector<uint32_t>> arenas;
+};
+
+template<typename Tree>
+BatchResult QueryExecutor::rangeSearch(const Tree& tree, const std::vector<typename Tree::Box>& boxes) {
+    for (std::vector<uint32_t>& arena : arenas) {
+        arena.clear();
+    }
+    
+    // Each query is answered by exactly one thread, which records where its hits went
+    std::vector<unsigned> owner(boxes.size());
+    std::vector<size_t> start(boxes.size());
+    BatchResult result;
+    result.offsets.assign(boxes.size() + 1, 0);
+    
+    pool.parallelFor(boxes.size(), grain, [&](unsigned thread, size_t first, size_t last) {
+        std::vector<uint32_t>& arena = arenas[thread];
+        for (size_t q = first; q < last; ++q) {
+            owner[q] = thread;
+            start[q] = arena.size();
+            tree.rangeSearchInto(boxes[q].low, boxes[q].high, arena);
+            result.offsets[q + 1] = arena.size() - start[q];
+        }
+    });
+    
+    // Merge: lay the queries out in order and copy every slice in parallel
+    std::partial_sum(result.offsets.begin(), result.offsets.end(), result.offsets.begin());
+    result.indices.resize(result.offsets.back());
+    pool.parallelFor(boxes.size(), grain, [&](unsigned, size_t first, size_t last) {
+        for (size_t q = first; q < last; ++q) {
+            const uint32_t* slice = arenas[owner[q]].data() + start[q];
+            std::copy(slice, slice + (result.offsets[q + 1] - result.offsets[q]),
+                      result.indices.begin() + result.offsets[q]);
+        }
+    });
+    return result;
+}
+
+template<typename Tree>
+std::vector<size_t> QueryExecutor::rangeCount(const Tree& tree, const std::vector<typename Tree::Box>& boxes) {
+    std::vector<size_t> counts(boxes.size());
+    pool.parallelFor(boxes.size(), grain, [&](unsigned, size_t first, size_t last) {
+        for (size_t q = first; q < last; ++q) {
+            counts[q] = tree.rangeCount(boxes[q].low, boxes[q].high);
+        }
+    });
+    return counts;
+}
@@ -2,353 +2,2364 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <initializer_list>
 #include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <set>
+#include <cstdint>
+#include <limits>
+#include <cmath>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <string>
+#include <functional>
+#include <utility>
+#include <iterator>
+#include "TreeImage.h"
+#include "BucketScan.h"
 
-template<typename T, size_t K>
-class RangeTree {
-private:
-    // Primary node structure for the range tree
-    struct Node {
-        std::vector<T> point;
-        std::unique_ptr<Node> left;
-        std::unique_ptr<Node> right;
-        std::unique_ptr<RangeTree<T, K-1>> next_level_tree; // For next dimension
-        std::vector<std::vector<T>> canonical_subset; // Points in this subtree
-        
-        Node(const std::vector<T>& pt) : point(pt), left(nullptr), right(nullptr), next_level_tree(nullptr) {}
-    };
+// Construction-time layout options
+struct BuildOptions {
+    // Replace the 1D associated trees of the last two dimensions with
+    // fractional cascading, dropping one log factor from the query cost
+    bool fractional_cascading = false;
     
-    std::unique_ptr<Node> root;
-    size_t dimension; // Current dimension this tree is sorted by
+    // Build threads; 0 uses every hardware thread. The result does not depend on it.
+    unsigned threads = 1;
     
-    // Helper methods
-    std::unique_ptr<Node> buildTree(std::vector<std::vector<T>>& points, size_t begin, size_t end);
-    void findSplitNode(const Node* node, T value, const Node** split_node) const;
-    void collectPoints(const Node* node, std::vector<std::vector<T>>& result) const;
-    void rangeSearchDim(const Node* node, const std::vector<T>& low, const std::vector<T>& high, 
-                        std::vector<std::vector<T>>& result) const;
-    bool isPointInRange(const std::vector<T>& point, const std::vector<T>& low, const std::vector<T>& high) const;
+    // Associated levels over fewer positions are always built on the calling thread
+    size_t parallel_cutoff = 1 << 15;
     
-public:
-    RangeTree(const std::vector<std::vector<T>>& points, size_t dim = 0);
-    std::vector<std::vector<T>> rangeSearch(const std::vector<T>& low, const std::vector<T>& high) const;
-    bool search(const std::vector<T>& point) const;
+    // Subtrees of at most this many points are leaf buckets: queries filter them with a
+    // column scan instead of descending, and they get no associated trees. 0 disables.
+    size_t leaf_size = 32;
+    
+    // When set, the point store and every level array are carved from this arena,
+    // which the tree keeps alive; tearing the tree down then frees its chunks only
+    std::shared_ptr<Arena> arena;
 };
 
-// Specialization for 1D Range Tree (base case for recursion)
+// State shared by every level while one tree is being built
+struct BuildContext {
+    std::vector<std::vector<uint32_t>> presorted; // Point indices sorted by each dimension
+    std::atomic<unsigned> spare_threads;
+    
+    explicit BuildContext(const BuildOptions& options) {
+        unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+        spare_threads = threads > 1 ? threads - 1 : 0;
+    }
+    
+    // Runs task on a thread of its own if one is spare, otherwise right away on this one
+    template<typename Task>
+    std::future<void> spawn(Task task) {
+        unsigned spare = spare_threads.load();
+        while (spare > 0) {
+            if (spare_threads.compare_exchange_weak(spare, spare - 1)) {
+                return std::async(std::launch::async, [this, task = std::move(task)]() mutable {
+                    struct Release {
+                        std::atomic<unsigned>& count;
+                        ~Release() { ++count; }
+                    } release{spare_threads};
+                    task();
+                });
+            }
+        }
+        task();
+        std::promise<void> done;
+        done.set_value();
+        return done.get_future();
+    }
+};
+
+// Coordinates of all points, shared by every level of a tree. Each dimension is one
+// contiguous column indexed by input position, so filtering or gathering a single
+// dimension streams through one array.
 template<typename T>
-class RangeTree<T, 1> {
-private:
-    // Node structure for 1D range tree
-    struct Node {
-        std::vector<T> point;
-        std::unique_ptr<Node> left;
-        std::unique_ptr<Node> right;
-        std::vector<std::vector<T>> canonical_subset;
-        
-        Node(const std::vector<T>& pt) : point(pt), left(nullptr), right(nullptr) {}
-    };
+struct PointStore {
+    FlatArray<T> coords; // Column d is coords[d * count, (d + 1) * count)
+    FlatArray<uint32_t> widths; // Coordinates of each point when they differ, else empty
+    size_t dims; // Coordinates per point, of the widest one
+    size_t count;
+    size_t first_axis; // Stored dimension the tree indexes as axis 0
+    std::shared_ptr<const void> backing; // Owner of the coordinates of an opened image
     
-    std::unique_ptr<Node> root;
-    size_t dimension;
+    size_t size() const { return count; }
+    size_t width(uint32_t index) const { return widths.empty() ? dims : widths[index]; }
     
-    // Helper methods
-    std::unique_ptr<Node> buildTree(std::vector<std::vector<T>>& points, size_t begin, size_t end);
-    void findSplitNode(const Node* node, T value, const Node** split_node) const;
-    void collectPoints(const Node* node, std::vector<std::vector<T>>& result) const;
-    void rangeSearchDim(const Node* node, const T& low, const T& high, 
-                     std::vector<std::vector<T>>& result) const;
-    bool isPointInRange(const std::vector<T>& point, const T& low, const T& high) const;
+    const T* column(size_t dim) const { return coords.data() + dim * count; }
+    const T& coord(uint32_t index, size_t dim) const { return column(dim)[index]; }
+    const T* axis(size_t a) const { return column(first_axis + a); }
+};
+
+// Materialized points of a hit list, gathered one column at a time
+template<typename T>
+std::vector<std::vector<T>> gatherRows(const PointStore<T>& store, const std::vector<uint32_t>& indices) {
+    std::vector<std::vector<T>> rows(indices.size(), std::vector<T>(store.dims));
+    for (size_t d = 0; d < store.dims; ++d) {
+        const T* column = store.column(d);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            rows[i][d] = column[indices[i]];
+        }
+    }
+    if (!store.widths.empty()) {
+        for (size_t i = 0; i < indices.size(); ++i) rows[i].resize(store.widths[indices[i]]);
+    }
+    return rows;
+}
+
+// Only the requested dimensions of a hit list: result[j] holds dimension dims[j] of every hit
+template<typename T>
+std::vector<std::vector<T>> gatherColumns(const PointStore<T>& store, const std::vector<uint32_t>& indices,
+                                          const std::vector<size_t>& dims) {
+    std::vector<std::vector<T>> columns;
+    columns.reserve(dims.size());
+    for (size_t dim : dims) {
+        if (dim >= store.dims) {
+            throw std::invalid_argument("Requested column is not stored by the tree");
+        }
+        const T* column = store.column(dim);
+        columns.emplace_back(indices.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            if (dim >= store.width(indices[i])) {
+                throw std::invalid_argument("Requested column is not stored for every point in the box");
+            }
+            columns.back()[i] = column[indices[i]];
+        }
+    }
+    return columns;
+}
+
+// Size of the left subtree of a complete binary tree with count nodes
+inline size_t leftSubtreeSize(size_t count) {
+    if (count <= 1) return 0;
+#if defined(__GNUC__)
+    size_t height = sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(count);
+#else
+    size_t height = 0;
+    while ((static_cast<size_t>(2) << height) <= count) ++height;
+#endif
+    size_t above = (static_cast<size_t>(1) << height) - 1; // Nodes above the last level
+    size_t half = static_cast<size_t>(1) << (height - 1); // Last-level slots under the left child
+    return above / 2 + std::min(count - above, half);
+}
+
+// Trees are stored implicitly: the tree over a sorted range of positions is the complete
+// binary tree with its keys in BFS order, so children are found by index arithmetic and
+// every subtree is again a contiguous sub-range. A node is just a position in that walk.
+struct TreeCursor {
+    size_t index; // BFS index within the tree
+    uint32_t begin, mid, end; // Subtree range and the position of the node itself
+    uint32_t depth;
     
-public:
-    RangeTree(const std::vector<std::vector<T>>& points, size_t dim = 0);
-    std::vector<std::vector<T>> rangeSearch(const std::vector<T>& low, const std::vector<T>& high) const;
-    bool search(const std::vector<T>& point) const;
+    TreeCursor(size_t i, uint32_t b, uint32_t e, uint32_t d)
+        : index(i), begin(b), mid(b + static_cast<uint32_t>(leftSubtreeSize(e - b))), end(e), depth(d) {}
+    
+    static TreeCursor root(uint32_t begin, uint32_t end) { return TreeCursor(0, begin, end, 0); }
+    bool empty() const { return begin >= end; }
+    TreeCursor left() const { return TreeCursor(2 * index + 1, begin, mid, depth + 1); }
+    TreeCursor right() const { return TreeCursor(2 * index + 2, mid + 1, end, depth + 1); }
 };
 
-// Implementation for K-dimensional Range Tree
+struct TreeRange {
+    uint32_t begin, end;
+};
 
-template<typename T, size_t K>
-RangeTree<T, K>::RangeTree(const std::vector<std::vector<T>>& points, size_t dim) : dimension(dim) {
-    if (points.empty()) return;
+// Node ranges of every tree in a forest, grouped by depth
+inline std::vector<std::vector<TreeRange>> rangesByDepth(const std::vector<TreeRange>& trees) {
+    std::vector<std::vector<TreeRange>> depths;
+    std::vector<TreeRange> current;
+    for (const TreeRange& tree : trees) {
+        if (tree.begin < tree.end) current.push_back(tree);
+    }
     
-    // Validate input points - ensure points have at least K dimensions
-    for (const auto& point : points) {
-        if (point.size() < K) {
-            throw std::invalid_argument("Point dimension does not match tree dimension");
+    while (!current.empty()) {
+        std::vector<TreeRange> next;
+        for (const TreeRange& range : current) {
+            TreeCursor node = TreeCursor::root(range.begin, range.end);
+            if (node.begin < node.mid) next.push_back({node.begin, node.mid});
+            if (node.mid + 1 < node.end) next.push_back({node.mid + 1, node.end});
+        }
+        depths.push_back(std::move(current));
+        current = std::move(next);
+    }
+    return depths;
+}
+
+// Per-query instrumentation, compiled in only with -DRANGE_TREE_QUERY_STATS=1. The
+// counters belong to the calling thread and add up over its queries until reset, e.g.
+//     threadQueryStats() = QueryStats();
+//     tree.rangeSearch(low, high);
+//     size_t visited = threadQueryStats().nodes_visited;
+// They follow the single-query traversal; batches count only where they fall back onto it.
+#ifndef RANGE_TREE_QUERY_STATS
+#define RANGE_TREE_QUERY_STATS 0
+#endif
+
+struct QueryStats {
+    size_t nodes_visited = 0; // Tree nodes whose key was compared, on every level
+    size_t canonical_subtrees = 0; // Covered subtrees handed to the next level, a bucket or a slice
+    size_t points_tested = 0; // Boundary-path points checked against the remaining axes
+    size_t bucket_scans = 0;
+    size_t bucket_points = 0; // Positions filtered by those scans
+    size_t points_reported = 0;
+};
+
+inline QueryStats& threadQueryStats() {
+    static thread_local QueryStats stats;
+    return stats;
+}
+
+#if RANGE_TREE_QUERY_STATS
+#define RANGE_TREE_COUNT(counter, amount) (threadQueryStats().counter += (amount))
+#else
+#define RANGE_TREE_COUNT(counter, amount) ((void)0)
+#endif
+
+// First position of the tree over [begin, end) whose key is not below value
+template<typename T, typename Compare>
+uint32_t lowerBound(const T* keys, uint32_t begin, uint32_t end, const T& value, Compare less) {
+    uint32_t bound = end;
+    TreeCursor node = TreeCursor::root(begin, end);
+    while (!node.empty()) {
+        RANGE_TREE_COUNT(nodes_visited, 1);
+        if (less(keys[begin + node.index], value)) {
+            node = node.right();
+        } else {
+            bound = node.mid;
+            node = node.left();
+        }
+    }
+    return bound;
+}
+
+// First position of the tree over [begin, end) whose key is above value
+template<typename T, typename Compare>
+uint32_t upperBound(const T* keys, uint32_t begin, uint32_t end, const T& value, Compare less) {
+    uint32_t bound = end;
+    TreeCursor node = TreeCursor::root(begin, end);
+    while (!node.empty()) {
+        RANGE_TREE_COUNT(nodes_visited, 1);
+        if (less(value, keys[begin + node.index])) {
+            bound = node.mid;
+            node = node.left();
+        } else {
+            node = node.right();
         }
     }
+    return bound;
+}
+
+// Receivers of the canonical decomposition: points reported one at a time on the
+// boundary paths, and slices of a level's order that lie entirely inside the box.
+// Returning false from either stops the query.
+struct CollectIndices {
+    std::vector<uint32_t>& indices;
     
-    // Make a copy of points for sorting
-    std::vector<std::vector<T>> sorted_points = points;
+    bool point(uint32_t index) { indices.push_back(index); return true; }
+    bool slice(const uint32_t* first, const uint32_t* last) { indices.insert(indices.end(), first, last); return true; }
+};
+
+struct FindAny {
+    bool found;
     
-    // Sort points by current dimension
-    std::sort(sorted_points.begin(), sorted_points.end(), 
-              [dim](const std::vector<T>& a, const std::vector<T>& b) {
-                  return a[dim] < b[dim];
-              });
+    bool point(uint32_t) { found = true; return false; }
+    bool slice(const uint32_t* first, const uint32_t* last) { found = first != last; return !found; }
+};
+
+struct CountPoints {
+    size_t count;
     
-    // Build the tree
-    root = buildTree(sorted_points, 0, sorted_points.size());
+    bool point(uint32_t) { ++count; return true; }
+    bool slice(const uint32_t* first, const uint32_t* last) { count += last - first; return true; }
+};
+
+// Every hit of a single query reaches its sink through these, so it can be counted
+template<typename Sink>
+bool reportPoint(Sink& sink, uint32_t index) {
+    RANGE_TREE_COUNT(points_reported, 1);
+    return sink.point(index);
 }
 
-template<typename T, size_t K>
-std::unique_ptr<typename RangeTree<T, K>::Node> RangeTree<T, K>::buildTree(
-    std::vector<std::vector<T>>& points, size_t begin, size_t end) {
+template<typename Sink>
+bool reportSlice(Sink& sink, const uint32_t* first, const uint32_t* last) {
+    RANGE_TREE_COUNT(points_reported, last - first);
+    return sink.slice(first, last);
+}
+
+// Tests one point against the bounds of axes [First, Last), unrolled at compile time.
+// Bounds are indexed by axis, like every query pointer below the public entry points.
+template<size_t First, size_t Last>
+struct AxesInside {
+    template<typename T, typename Compare>
+    static bool check(const PointStore<T>& store, uint32_t point, const T* low, const T* high, Compare less) {
+        const T& value = store.axis(First)[point];
+        return !less(value, low[First]) && !less(high[First], value) &&
+               AxesInside<First + 1, Last>::check(store, point, low, high, less);
+    }
     
-    if (begin >= end) return nullptr;
+    template<typename T, typename Compare>
+    static bool equal(const PointStore<T>& store, uint32_t point, const T* other, Compare less) {
+        const T& value = store.axis(First)[point];
+        return !less(value, other[First]) && !less(other[First], value) &&
+               AxesInside<First + 1, Last>::equal(store, point, other, less);
+    }
+};
+
+template<size_t Last>
+struct AxesInside<Last, Last> {
+    template<typename T, typename Compare>
+    static bool check(const PointStore<T>&, uint32_t, const T*, const T*, Compare) { return true; }
     
-    size_t mid = begin + (end - begin) / 2;
-    auto node = std::make_unique<Node>(points[mid]);
+    template<typename T, typename Compare>
+    static bool equal(const PointStore<T>&, uint32_t, const T*, Compare) { return true; }
+};
+
+// Streams hits to a caller's visitor as (input index, stored coordinates). The
+// coordinates are gathered from the columns into a buffer on the query's stack, valid
+// during the call; only stores wider than the buffer fall back to one heap row.
+template<typename T, typename Visitor, size_t Dims>
+struct VisitPoints {
+    static const size_t inline_dims = Dims > 16 ? Dims : 16;
     
-    // Store canonical subset (all points in this subtree)
-    for (size_t i = begin; i < end; ++i) {
-        node->canonical_subset.push_back(points[i]);
-    }
+    const PointStore<T>& store;
+    Visitor& visit;
+    std::array<T, inline_dims> inline_row;
+    std::vector<T> wide_row;
+    T* row;
     
-    // Build subtrees
-    node->left = buildTree(points, begin, mid);
-    node->right = buildTree(points, mid + 1, end);
+    VisitPoints(const PointStore<T>& points, Visitor& visitor)
+        : store(points), visit(visitor), inline_row(), wide_row(points.dims > inline_dims ? points.dims : 0),
+          row(points.dims > inline_dims ? wide_row.data() : inline_row.data()) {}
+    VisitPoints(const VisitPoints&) = delete;
     
-    // Build next level tree for next dimension if not at last dimension
-    if (dimension + 1 < K) {
-        node->next_level_tree = std::make_unique<RangeTree<T, K-1>>(node->canonical_subset, dimension + 1);
+    bool point(uint32_t index) {
+        for (size_t d = 0; d < store.dims; ++d) row[d] = store.coord(index, d);
+        return visit(index, static_cast<const T*>(row));
+    }
+    bool slice(const uint32_t* first, const uint32_t* last) {
+        for (; first != last; ++first) {
+            if (!point(*first)) return false;
+        }
+        return true;
     }
+};
+
+// Bounds of one query of a batch, over every dimension of the tree
+template<typename T>
+struct QueryBounds {
+    const T* low;
+    const T* high;
+};
+
+// Batch receivers get the query id alongside each hit
+struct CountBatch {
+    size_t* counts;
     
-    return node;
-}
+    void point(uint32_t query, uint32_t) { ++counts[query]; }
+    void slice(uint32_t query, const uint32_t* first, const uint32_t* last) { counts[query] += last - first; }
+};
 
-template<typename T, size_t K>
-void RangeTree<T, K>::findSplitNode(const Node* node, T value, const Node** split_node) const {
-    if (!node) return;
+struct CollectBatch {
+    std::vector<uint32_t>* hits; // One buffer per query
     
-    // If node's value matches search value exactly, this is the split node
-    if (node->point[dimension] == value) {
-        *split_node = node;
-        return;
+    void point(uint32_t query, uint32_t index) { hits[query].push_back(index); }
+    void slice(uint32_t query, const uint32_t* first, const uint32_t* last) {
+        hits[query].insert(hits[query].end(), first, last);
     }
+};
+
+// Feeds the hits of one query of a batch through the single-query traversal
+template<typename Sink>
+struct SingleQuery {
+    Sink& sink;
+    uint32_t query;
     
-    // Navigate to find the split node
-    if (value < node->point[dimension]) {
-        // Update split node candidate and go left
-        *split_node = node;
-        findSplitNode(node->left.get(), value, split_node);
-    } else {
-        // Go right
-        findSplitNode(node->right.get(), value, split_node);
+    bool point(uint32_t index) { sink.point(query, index); return true; }
+    bool slice(const uint32_t* first, const uint32_t* last) { sink.slice(query, first, last); return true; }
+};
+
+// Hits of a whole batch in one buffer: query q owns indices[offsets[q], offsets[q + 1])
+struct BatchResult {
+    std::vector<uint32_t> indices; // Positions of the points in the input
+    std::vector<size_t> offsets;
+};
+
+// Lays out per-query hit buffers back to back, releasing each once it is copied
+inline BatchResult packBatch(std::vector<std::vector<uint32_t>>& hits) {
+    BatchResult result;
+    result.offsets.assign(hits.size() + 1, 0);
+    for (size_t q = 0; q < hits.size(); ++q) {
+        result.offsets[q + 1] = result.offsets[q] + hits[q].size();
+    }
+    result.indices.reserve(result.offsets.back());
+    for (auto& query : hits) {
+        result.indices.insert(result.indices.end(), query.begin(), query.end());
+        std::vector<uint32_t>().swap(query);
     }
+    return result;
 }
 
-template<typename T, size_t K>
-void RangeTree<T, K>::collectPoints(const Node* node, std::vector<std::vector<T>>& result) const {
-    if (!node) return;
+// Shape and footprint of the level indexing one axis, summed over all its forests
+struct LevelStats {
+    size_t forests = 0; // One at the top, one per searched depth of the level above below it
+    size_t trees = 0; // Implicit trees across those forests, one per node of the level above
+    size_t references = 0; // Point indices stored, i.e. positions of the level arrays
+    size_t height = 0; // Node levels of the tallest tree
+    double balance = 0; // Worst ratio of a tree's height to the least height for its size
+    size_t order_bytes = 0;
+    size_t key_bytes = 0;
+    size_t bucket_bytes = 0; // Leaf-bucket coordinate columns
+    size_t cascade_bytes = 0; // Cascade subsets and their bridges
     
-    // Add all points from this node's canonical subset
-    result.insert(result.end(), node->canonical_subset.begin(), node->canonical_subset.end());
-}
+    size_t bytes() const { return order_bytes + key_bytes + bucket_bytes + cascade_bytes; }
+};
 
-template<typename T, size_t K>
-bool RangeTree<T, K>::isPointInRange(
-    const std::vector<T>& point, const std::vector<T>& low, const std::vector<T>& high) const {
+// Structure of a built tree for capacity planning. Bytes count the flat arrays a tree
+// stores, whether owned, carved from an arena or mapped from an image; the level
+// objects holding them add a small constant per forest.
+struct TreeStats {
+    size_t points = 0;
+    size_t point_bytes = 0; // Coordinate columns shared by every level
+    std::vector<LevelStats> levels; // levels[a] indexes axis a
     
-    for (size_t i = 0; i < K; ++i) {
-        if (point[i] < low[i] || point[i] > high[i]) {
-            return false;
-        }
+    size_t references() const {
+        size_t total = 0;
+        for (const LevelStats& level : levels) total += level.references;
+        return total;
+    }
+    size_t nodeBytes() const { return levels.empty() ? 0 : levels[0].bytes(); }
+    size_t associatedBytes() const {
+        size_t total = 0;
+        for (size_t a = 1; a < levels.size(); ++a) total += levels[a].bytes();
+        return total;
+    }
+    size_t bytes() const { return point_bytes + nodeBytes() + associatedBytes(); }
+};
+
+// Adds one forest's trees to the height and balance of its level. Trees are complete,
+// so the left spine is always a longest path.
+inline void addTreeShapes(const std::vector<TreeRange>& trees, LevelStats& level) {
+    for (const TreeRange& tree : trees) {
+        size_t height = 0;
+        for (TreeCursor node = TreeCursor::root(tree.begin, tree.end); !node.empty(); node = node.left()) ++height;
+        size_t least = 0;
+        while ((size_t(1) << least) <= tree.end - tree.begin) ++least;
+        level.height = std::max(level.height, height);
+        if (least > 0) level.balance = std::max(level.balance, static_cast<double>(height) / least);
     }
-    return true;
 }
 
+// How one side of a query box constrains its dimension
+enum class Bound : uint8_t {
+    Unbounded, // Any value passes; the dimension is not compared on this side
+    Closed, // The bound value itself is inside
+    Open // The bound value itself is outside
+};
+
+// Query box with its own bound kind on each side of every dimension. A default box is
+// unbounded everywhere, and the builders constrain one dimension at a time, e.g.
+// QueryBox<double, 2>().lower(0, x0).upper(0, x1, Bound::Open) tiles the x axis.
 template<typename T, size_t K>
-void RangeTree<T, K>::rangeSearchDim(
-    const Node* node, const std::vector<T>& low, const std::vector<T>& high, 
-    std::vector<std::vector<T>>& result) const {
+struct QueryBox {
+    std::array<T, K> low{}, high{};
+    std::array<Bound, K> low_kind{}, high_kind{};
     
-    if (!node) return;
-    
-    // If current node's value is outside the range in the current dimension
-    if (node->point[dimension] < low[dimension]) {
-        rangeSearchDim(node->right.get(), low, high, result);
-        return;
+    QueryBox& lower(size_t dim, const T& value, Bound kind = Bound::Closed) {
+        low[dim] = value;
+        low_kind[dim] = kind;
+        return *this;
     }
-    
-    if (node->point[dimension] > high[dimension]) {
-        rangeSearchDim(node->left.get(), low, high, result);
-        return;
+    QueryBox& upper(size_t dim, const T& value, Bound kind = Bound::Closed) {
+        high[dim] = value;
+        high_kind[dim] = kind;
+        return *this;
     }
+    QueryBox& between(size_t dim, const T& lo, const T& hi) { return lower(dim, lo).upper(dim, hi); }
+};
+
+// Extremes and adjacent values of T in the order of Compare, for the orders that have
+// them: the natural one and its reverse on arithmetic types
+template<typename T, typename Compare>
+struct OrderLimits {
+    static const bool known = false;
+};
+
+template<typename T>
+struct OrderLimits<T, std::less<T>> {
+    static const bool known = std::numeric_limits<T>::is_specialized;
     
-    // Check if the current point is in the range for all dimensions
-    if (isPointInRange(node->point, low, high)) {
-        result.push_back(node->point);
+    static T first() { return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest(); }
+    static T last() { return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max(); }
+    // Adjacent value after (or before) value, false at the end of the order
+    static bool step(const T& value, bool up, T& next) {
+        if (value == (up ? last() : first())) return false;
+        next = stepValue(value, up, std::is_integral<T>());
+        return true;
     }
+    static T stepValue(const T& value, bool up, std::true_type) { return up ? value + 1 : value - 1; }
+    static T stepValue(const T& value, bool up, std::false_type) { return std::nextafter(value, up ? last() : first()); }
+};
+
+template<typename T>
+struct OrderLimits<T, std::greater<T>> {
+    typedef OrderLimits<T, std::less<T>> Natural;
+    static const bool known = Natural::known;
     
-    // Check both subtrees
-    rangeSearchDim(node->left.get(), low, high, result);
-    rangeSearchDim(node->right.get(), low, high, result);
-}
+    static T first() { return Natural::last(); }
+    static T last() { return Natural::first(); }
+    static bool step(const T& value, bool up, T& next) { return Natural::step(value, !up, next); }
+};
 
+// A query box rewritten as closed bounds on every axis: open bounds move to the
+// adjacent value and unbounded sides to the extreme of the order. Axes with both sides
+// unbounded are also marked free, so the search never compares them.
 template<typename T, size_t K>
-std::vector<std::vector<T>> RangeTree<T, K>::rangeSearch(
-    const std::vector<T>& low, const std::vector<T>& high) const {
-    
-    if (low.size() < K || high.size() < K) {
-        throw std::invalid_argument("Range dimensions do not match tree dimension");
+struct ClosedBox {
+    std::array<T, K> low, high;
+    uint64_t free; // Bit a set when axis a is unconstrained
+    bool empty; // An open bound excludes everything
+};
+
+template<typename T, typename Compare, size_t K>
+void closeSide(const QueryBox<T, K>& box, size_t dim, bool lower, ClosedBox<T, K>& closed, std::true_type) {
+    typedef OrderLimits<T, Compare> Limits;
+    const Bound kind = lower ? box.low_kind[dim] : box.high_kind[dim];
+    const T& value = lower ? box.low[dim] : box.high[dim];
+    T& bound = lower ? closed.low[dim] : closed.high[dim];
+    if (kind == Bound::Unbounded) {
+        bound = lower ? Limits::first() : Limits::last();
+    } else if (kind == Bound::Closed) {
+        bound = value;
+    } else if (!Limits::step(value, lower, bound)) {
+        closed.empty = true;
     }
-    
-    std::vector<std::vector<T>> result;
-    if (!root) return result;
-    
-    // Find results for current dimension
-    rangeSearchDim(root.get(), low, high, result);
-    
-    return result;
 }
 
-template<typename T, size_t K>
-bool RangeTree<T, K>::search(const std::vector<T>& point) const {
-    if (point.size() < K) {
-        throw std::invalid_argument("Point dimension does not match tree dimension");
+template<typename T, typename Compare, size_t K>
+void closeSide(const QueryBox<T, K>& box, size_t dim, bool lower, ClosedBox<T, K>& closed, std::false_type) {
+    if ((lower ? box.low_kind[dim] : box.high_kind[dim]) != Bound::Closed) {
+        throw std::invalid_argument("Open and unbounded sides need an arithmetic type in its natural or reverse order");
     }
-    
-    // Create a range query where low = high = point
-    return !rangeSearch(point, point).empty();
+    (lower ? closed.low[dim] : closed.high[dim]) = lower ? box.low[dim] : box.high[dim];
 }
 
-// Implementation for 1D Range Tree
-
-template<typename T>
-RangeTree<T, 1>::RangeTree(const std::vector<std::vector<T>>& points, size_t dim) : dimension(dim) {
-    if (points.empty()) return;
-    
-    // Validate input points
-    for (const auto& point : points) {
-        if (point.size() < 1) {
-            throw std::invalid_argument("Point dimension does not match tree dimension");
+template<typename T, typename Compare, size_t K>
+ClosedBox<T, K> closeBox(const QueryBox<T, K>& box) {
+    ClosedBox<T, K> closed;
+    closed.free = 0;
+    closed.empty = false;
+    for (size_t d = 0; d < K; ++d) {
+        std::integral_constant<bool, OrderLimits<T, Compare>::known> limits;
+        closeSide<T, Compare>(box, d, true, closed, limits);
+        closeSide<T, Compare>(box, d, false, closed, limits);
+        if (box.low_kind[d] == Bound::Unbounded && box.high_kind[d] == Bound::Unbounded) {
+            closed.free |= uint64_t(1) << d;
         }
     }
+    return closed;
+}
+
+// Reads the levels and cascades of a tree to attach side tables to them
+template<typename Table>
+class SliceTables;
+
+// A tree is immutable once built: every query is const and keeps its state on the
+// caller's stack, so any number of threads may query one tree at the same time
+template<typename T, size_t K, typename Compare = std::less<T>, size_t Axis = 0>
+class RangeTree {
+private:
+    std::shared_ptr<const PointStore<T>> store; // All levels share one copy of the input
     
-    // Make a copy of points for sorting
-    std::vector<std::vector<T>> sorted_points = points;
+    // A level is a forest of implicit trees over positions [0, n): the top level is a
+    // single tree, an associated level has one tree per node at some depth of the level
+    // above. A tree's range of order holds its point indices sorted by the current
+    // dimension, and the same range of keys holds their values in BFS order.
+    FlatArray<uint32_t> order;
+    FlatArray<T> keys;
+    FlatArray<T> columns; // Leaf buckets: column d holds axis Axis + d of every position
+    std::vector<RangeTree<T, K-1, Compare, Axis+1>> next_level; // Associated trees of the nodes at each depth above the buckets
+    BuildOptions options;
     
-    // Sort points by the single dimension
-    std::sort(sorted_points.begin(), sorted_points.end(), 
-              [](const std::vector<T>& a, const std::vector<T>& b) {
-                  return a[0] < b[0];
-              });
+    // Fractional cascading (last two dimensions only), one array per tree depth:
+    // cascade[d][begin, end) is the subset of a depth-d node sorted by the next
+    // dimension, and *_bridge[d][i] is the first position of the child's range in
+    // cascade[d + 1] whose next-dimension value is not below that of cascade[d][i]
+    std::vector<FlatArray<uint32_t>> cascade;
+    std::vector<FlatArray<uint32_t>> left_bridge;
+    std::vector<FlatArray<uint32_t>> right_bridge;
     
-    // Build the tree
-    root = buildTree(sorted_points, 0, sorted_points.size());
-}
+    // Associated trees are built and queried directly by the level above
+    template<typename, size_t, typename, size_t> friend class RangeTree;
+    template<typename> friend class SliceTables;
+    
+    RangeTree(std::shared_ptr<const PointStore<T>> points, std::vector<uint32_t> sorted,
+              const std::vector<TreeRange>& trees, const BuildOptions& opts, BuildContext& context);
+    RangeTree(std::shared_ptr<const PointStore<T>> points, ImageReader& image, const BuildOptions& opts);
+    
+    // Helper methods
+    void init();
+    void buildForest(const std::vector<TreeRange>& trees, BuildContext& context);
+    void saveLevel(ImageWriter& image) const;
+    void fillKeys(const TreeCursor& node, uint32_t tree_begin, std::vector<T>& values) const;
+    void buildCascade(const std::vector<std::vector<TreeRange>>& depths);
+    TreeCursor findSplitNode(uint32_t begin, uint32_t end, const T& low, const T& high) const;
+    TreeCursor cascadeChild(const TreeCursor& node, bool left, size_t& first, size_t& last) const;
+    template<typename Sink>
+    bool rangeSearchDim(uint32_t begin, uint32_t end, const T* low, const T* high, Sink& sink,
+                        uint64_t free = 0) const;
+    template<typename Sink>
+    bool rangeSearchCascading(uint32_t begin, uint32_t end, const T* low, const T* high, Sink& sink,
+                              uint64_t free) const;
+    bool isPointInRange(uint32_t point, const T* low, const T* high) const;
+    template<typename Sink>
+    bool scanBucket(const TreeCursor& node, size_t from, const T* low, const T* high, Sink& sink) const;
+    template<typename Sink>
+    bool searchCovered(const TreeCursor& covered, const T* low, const T* high, Sink& sink, uint64_t free) const;
+    bool containsPoint(const T* point) const;
+    template<typename Sink>
+    bool searchBox(const QueryBox<T, K>& box, Sink& sink) const;
+    void addStats(const std::vector<TreeRange>& trees, TreeStats& stats) const;
+    template<typename Sink>
+    void rangeSearchBatchDim(uint32_t begin, uint32_t end, const QueryBounds<T>* bounds,
+                             uint32_t* queries, size_t count, Sink& sink) const;
+    template<typename Sink>
+    void batchSplit(const TreeCursor& node, uint32_t tree_begin, const QueryBounds<T>* bounds,
+                    uint32_t* queries, size_t count, Sink& sink) const;
+    template<typename Sink>
+    void batchPath(TreeCursor node, bool left_path, uint32_t tree_begin, const QueryBounds<T>* bounds,
+                   uint32_t* queries, size_t count, Sink& sink) const;
+    template<typename Sink>
+    void batchBucket(const TreeCursor& node, size_t from, const QueryBounds<T>* bounds,
+                     const uint32_t* queries, size_t count, Sink& sink) const;
+    template<typename Boxes, typename Sink>
+    void runBatch(const Boxes& boxes, Sink& sink) const;
+    bool isCascading() const { return K == 2 && options.fractional_cascading; }
+    bool isBucket(const TreeCursor& node) const { return node.end - node.begin <= options.leaf_size; }
+    const T& coord(uint32_t point, size_t axis) const { return store->axis(axis)[point]; }
+    const T* axes(const std::vector<T>& coords) const { return coords.data() + store->first_axis; }
+    static bool less(const T& a, const T& b) { return Compare()(a, b); }
 
-template<typename T>
-std::unique_ptr<typename RangeTree<T, 1>::Node> RangeTree<T, 1>::buildTree(
-    std::vector<std::vector<T>>& points, size_t begin, size_t end) {
+public:
+    using Point = std::array<T, K>;
     
-    if (begin >= end) return nullptr;
+    struct Box {
+        Point low;
+        Point high;
+    };
+    
+    RangeTree(const std::vector<std::vector<T>>& points, size_t dim = 0);
+    RangeTree(const std::vector<std::vector<T>>& points, const BuildOptions& opts, size_t dim = 0);
+    RangeTree(const std::vector<Point>& points, const BuildOptions& opts = BuildOptions());
+    
+    // Takes ownership of the points: their buffer is transposed in place into the tree's
+    // columns, so the build adds no copy of the data. With an arena the columns are
+    // copied into it instead and the points freed right after.
+    RangeTree(std::vector<Point>&& points, const BuildOptions& opts = BuildOptions());
+    
+    // Points of any forward range, such as a span over a mapped file, read once into the columns
+    template<typename Iterator, typename = typename std::enable_if<
+                 std::is_convertible<decltype(*std::declval<Iterator&>()), const Point&>::value>::type>
+    RangeTree(Iterator first, Iterator last, const BuildOptions& opts = BuildOptions());
+    
+    // Indexes records in place of points: project(record, axis) yields the record's
+    // coordinate on each of the K axes, read once straight into the tree's columns
+    template<typename Record, typename Projection,
+             typename = decltype(std::declval<Projection&>()(std::declval<const Record&>(), size_t(0)))>
+    RangeTree(const std::vector<Record>& records, Projection project, const BuildOptions& opts = BuildOptions());
+    
+    // Point overloads skip all size checks; the vector ones validate and convert
+    std::vector<Point> rangeSearch(const Point& low, const Point& high) const;
+    std::vector<std::vector<T>> rangeSearch(const std::vector<T>& low, const std::vector<T>& high) const;
+    std::vector<std::vector<T>> rangeSearch(std::initializer_list<T> low, std::initializer_list<T> high) const;
     
-    size_t mid = begin + (end - begin) / 2;
-    auto node = std::make_unique<Node>(points[mid]);
+    // Hits as columns: result[j] holds stored dimension dims[j] of every point in the
+    // box, so only the requested coordinates are ever gathered
+    std::vector<std::vector<T>> rangeSearchColumns(const std::vector<T>& low, const std::vector<T>& high,
+                                                   const std::vector<size_t>& dims) const;
     
-    // Store canonical subset (all points in this subtree)
-    for (size_t i = begin; i < end; ++i) {
-        node->canonical_subset.push_back(points[i]);
+    // Input positions of the points in the box, ascending, e.g. into the records the
+    // tree was built from
+    std::vector<uint32_t> rangeSearchIndices(const Point& low, const Point& high) const;
+    std::vector<uint32_t> rangeSearchIndices(const std::vector<T>& low, const std::vector<T>& high) const;
+    
+    // Appends the input positions of the points in the box to indices, in traversal
+    // order, so a caller can collect many queries in one reused buffer
+    void rangeSearchInto(const Point& low, const Point& high, std::vector<uint32_t>& indices) const;
+    
+    // Indexed coordinates of the point at input position index, read from the columns
+    Point point(uint32_t index) const {
+        Point result;
+        for (size_t a = 0; a < K; ++a) result[a] = coord(index, a);
+        return result;
     }
     
-    // Build subtrees
-    node->left = buildTree(points, begin, mid);
-    node->right = buildTree(points, mid + 1, end);
+    // Streams every hit to visit(index, coords) without allocating, where index is the
+    // point's position in the input and coords its stored coordinates (padded past the
+    // width of a narrower point). The visitor returns false to stop early; the query
+    // returns false if it was stopped. Points of over max(K, 16) coordinates take one
+    // row on the heap per query.
+    template<typename Visitor>
+    bool rangeSearch(const Point& low, const Point& high, Visitor&& visit) const;
+    template<typename Visitor>
+    bool rangeSearch(const std::vector<T>& low, const std::vector<T>& high, Visitor&& visit) const;
+    template<typename Visitor>
+    bool rangeSearch(std::initializer_list<T> low, std::initializer_list<T> high, Visitor&& visit) const;
     
-    return node;
+    // Number of points in the box, summed over the decomposition without copying any
+    size_t rangeCount(const Point& low, const Point& high) const;
+    size_t rangeCount(const std::vector<T>& low, const std::vector<T>& high) const;
+    size_t rangeCount(std::initializer_list<T> low, std::initializer_list<T> high) const;
+    
+    // Boxes with a bound kind on each side of every axis. Fully unbounded axes are
+    // never compared, and subtrees whose remaining axes are all unbounded are reported
+    // without descending into the levels below them.
+    std::vector<Point> rangeSearch(const QueryBox<T, K>& box) const;
+    std::vector<uint32_t> rangeSearchIndices(const QueryBox<T, K>& box) const;
+    size_t rangeCount(const QueryBox<T, K>& box) const;
+    template<typename Visitor>
+    bool rangeSearch(const QueryBox<T, K>& box, Visitor&& visit) const;
+    
+    bool search(const Point& point) const;
+    bool search(const std::vector<T>& point) const;
+    bool search(std::initializer_list<T> point) const;
+    
+    // Membership of a whole batch, answered in key order for locality
+    std::vector<bool> contains(const std::vector<Point>& points) const;
+    
+    // Whole batches pushed through the tree together: queries that take the same
+    // way through a level share its nodes and the associated trees below them.
+    // Hits of each query come back as input indices, in no particular order.
+    BatchResult rangeSearchBatch(const std::vector<Box>& boxes) const;
+    std::vector<size_t> rangeCountBatch(const std::vector<Box>& boxes) const;
+    
+    // Per-level node counts, heights and bytes, found by walking the level arrays
+    TreeStats stats() const;
+    
+    // Flat image of the built tree: the point store and every level array. open()
+    // maps it and queries run on the mapped pages, without any deserialization.
+    void save(const std::string& path) const;
+    static RangeTree open(const std::string& path);
+};
+
+// Specialization for 1D Range Tree (base case for recursion)
+template<typename T, typename Compare, size_t Axis>
+class RangeTree<T, 1, Compare, Axis> {
+private:
+    std::shared_ptr<const PointStore<T>> store;
+    
+    // Forest of implicit trees, as in the general case: sorted point indices per tree
+    // range of order, and the matching values in BFS order in keys
+    FlatArray<uint32_t> order;
+    FlatArray<T> keys;
+    
+    template<typename, size_t, typename, size_t> friend class RangeTree;
+    template<typename> friend class SliceTables;
+    
+    RangeTree(std::shared_ptr<const PointStore<T>> points, std::vector<uint32_t> sorted,
+              const std::vector<TreeRange>& trees, const BuildOptions& opts, BuildContext& context);
+    RangeTree(std::shared_ptr<const PointStore<T>> points, ImageReader& image, const BuildOptions& opts);
+    
+    // Helper methods
+    void init(Arena* arena);
+    void buildForest(const std::vector<TreeRange>& trees, Arena* arena);
+    void saveLevel(ImageWriter& image) const;
+    void fillKeys(const TreeCursor& node, uint32_t tree_begin, std::vector<T>& values) const;
+    bool containsPoint(const T* point) const;
+    template<typename Sink>
+    bool rangeSearchDim(uint32_t begin, uint32_t end, const T* low, const T* high, Sink& sink,
+                        uint64_t free = 0) const;
+    template<typename Sink>
+    bool searchBox(const QueryBox<T, 1>& box, Sink& sink) const;
+    void addStats(const std::vector<TreeRange>& trees, TreeStats& stats) const;
+    template<typename Sink>
+    void rangeSearchBatchDim(uint32_t begin, uint32_t end, const QueryBounds<T>* bounds,
+                             uint32_t* queries, size_t count, Sink& sink) const;
+    template<typename Boxes, typename Sink>
+    void runBatch(const Boxes& boxes, Sink& sink) const;
+    const T& coord(uint32_t point) const { return store->axis(Axis)[point]; }
+    const T* axes(const std::vector<T>& coords) const { return coords.data() + store->first_axis; }
+    static bool less(const T& a, const T& b) { return Compare()(a, b); }
+
+public:
+    using Point = std::array<T, 1>;
+    
+    struct Box {
+        Point low;
+        Point high;
+    };
+    
+    RangeTree(const std::vector<std::vector<T>>& points, size_t dim = 0);
+    RangeTree(const std::vector<std::vector<T>>& points, const BuildOptions& opts, size_t dim = 0);
+    RangeTree(const std::vector<Point>& points, const BuildOptions& opts = BuildOptions());
+    
+    // Takes ownership of the points: their buffer is transposed in place into the tree's
+    // columns, so the build adds no copy of the data. With an arena the columns are
+    // copied into it instead and the points freed right after.
+    RangeTree(std::vector<Point>&& points, const BuildOptions& opts = BuildOptions());
+    
+    // Points of any forward range, such as a span over a mapped file, read once into the columns
+    template<typename Iterator, typename = typename std::enable_if<
+                 std::is_convertible<decltype(*std::declval<Iterator&>()), const Point&>::value>::type>
+    RangeTree(Iterator first, Iterator last, const BuildOptions& opts = BuildOptions());
+    
+    // Indexes records in place of points: project(record, axis) yields the record's
+    // coordinate on each of the K axes, read once straight into the tree's columns
+    template<typename Record, typename Projection,
+             typename = decltype(std::declval<Projection&>()(std::declval<const Record&>(), size_t(0)))>
+    RangeTree(const std::vector<Record>& records, Projection project, const BuildOptions& opts = BuildOptions());
+    
+    std::vector<Point> rangeSearch(const Point& low, const Point& high) const;
+    std::vector<std::vector<T>> rangeSearch(const std::vector<T>& low, const std::vector<T>& high) const;
+    std::vector<std::vector<T>> rangeSearch(std::initializer_list<T> low, std::initializer_list<T> high) const;
+    
+    // Hits as columns: result[j] holds stored dimension dims[j] of every point in the
+    // box, so only the requested coordinates are ever gathered
+    std::vector<std::vector<T>> rangeSearchColumns(const std::vector<T>& low, const std::vector<T>& high,
+                                                   const std::vector<size_t>& dims) const;
+    
+    // Input positions of the points in the box, ascending, e.g. into the records the
+    // tree was built from
+    std::vector<uint32_t> rangeSearchIndices(const Point& low, const Point& high) const;
+    std::vector<uint32_t> rangeSearchIndices(const std::vector<T>& low, const std::vector<T>& high) const;
+    
+    // Appends the input positions of the points in the box to indices, in traversal
+    // order, so a caller can collect many queries in one reused buffer
+    void rangeSearchInto(const Point& low, const Point& high, std::vector<uint32_t>& indices) const;
+    
+    // Indexed coordinate of the point at input position index
+    Point point(uint32_t index) const { return Point{{coord(index)}}; }
+    
+    // Streams every hit to visit(index, coords) without allocating, where index is the
+    // point's position in the input and coords its stored coordinates (padded past the
+    // width of a narrower point). The visitor returns false to stop early; the query
+    // returns false if it was stopped. Points of over 16 coordinates take one row on
+    // the heap per query.
+    template<typename Visitor>
+    bool rangeSearch(const Point& low, const Point& high, Visitor&& visit) const;
+    template<typename Visitor>
+    bool rangeSearch(const std::vector<T>& low, const std::vector<T>& high, Visitor&& visit) const;
+    template<typename Visitor>
+    bool rangeSearch(std::initializer_list<T> low, std::initializer_list<T> high, Visitor&& visit) const;
+    
+    // Number of points in the box, summed over the decomposition without copying any
+    size_t rangeCount(const Point& low, const Point& high) const;
+    size_t rangeCount(const std::vector<T>& low, const std::vector<T>& high) const;
+    size_t rangeCount(std::initializer_list<T> low, std::initializer_list<T> high) const;
+    
+    // Boxes with a bound kind on each side of every axis. Fully unbounded axes are
+    // never compared, and subtrees whose remaining axes are all unbounded are reported
+    // without descending into the levels below them.
+    std::vector<Point> rangeSearch(const QueryBox<T, 1>& box) const;
+    std::vector<uint32_t> rangeSearchIndices(const QueryBox<T, 1>& box) const;
+    size_t rangeCount(const QueryBox<T, 1>& box) const;
+    template<typename Visitor>
+    bool rangeSearch(const QueryBox<T, 1>& box, Visitor&& visit) const;
+    
+    bool search(const Point& point) const;
+    bool search(const std::vector<T>& point) const;
+    bool search(std::initializer_list<T> point) const;
+    
+    // Membership of a whole batch, answered in key order for locality
+    std::vector<bool> contains(const std::vector<Point>& points) const;
+    
+    // Whole batches pushed through the tree together: queries that take the same
+    // way through a level share its nodes and the associated trees below them.
+    // Hits of each query come back as input indices, in no particular order.
+    BatchResult rangeSearchBatch(const std::vector<Box>& boxes) const;
+    std::vector<size_t> rangeCountBatch(const std::vector<Box>& boxes) const;
+    
+    // Per-level node counts, heights and bytes, found by walking the level arrays
+    TreeStats stats() const;
+    
+    // Flat image of the built tree: the point store and every level array. open()
+    // maps it and queries run on the mapped pages, without any deserialization.
+    void save(const std::string& path) const;
+    static RangeTree open(const std::string& path);
+};
+
+// Identity permutation of 32-bit point indices
+inline std::vector<uint32_t> pointIndices(size_t count) {
+    if (count > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("Too many points for 32-bit point indices");
+    }
+    
+    std::vector<uint32_t> indices(count);
+    for (size_t i = 0; i < count; ++i) {
+        indices[i] = static_cast<uint32_t>(i);
+    }
+    return indices;
 }
 
+// Copies vector points into a store with all their coordinates, so rows come back as
+// they went in. Points narrower than the widest are padded and keep their own width.
 template<typename T>
-void RangeTree<T, 1>::findSplitNode(const Node* node, T value, const Node** split_node) const {
-    if (!node) return;
+std::shared_ptr<const PointStore<T>> makePointStore(const std::vector<std::vector<T>>& points, size_t first_axis,
+                                                    size_t axes, const std::shared_ptr<Arena>& arena) {
+    const size_t dims = first_axis + axes;
+    // Ensure points have at least as many dimensions as the tree
+    size_t stored_dims = dims;
+    bool ragged = false;
+    for (const auto& point : points) {
+        if (point.size() < dims) {
+            throw std::invalid_argument("Point dimension does not match tree dimension");
+        }
+        ragged = ragged || point.size() != points.front().size();
+        stored_dims = std::max(stored_dims, point.size());
+    }
     
-    // If node's value matches search value exactly, this is the split node
-    if (node->point[0] == value) {
-        *split_node = node;
-        return;
+    std::vector<T> coords(points.size() * stored_dims);
+    for (size_t i = 0; i < points.size(); ++i) {
+        for (size_t d = 0; d < points[i].size(); ++d) {
+            coords[d * points.size() + i] = points[i][d];
+        }
     }
     
-    // Navigate to find the split node
-    if (value < node->point[0]) {
-        // Update split node candidate and go left
-        *split_node = node;
-        findSplitNode(node->left.get(), value, split_node);
-    } else {
-        // Go right
-        findSplitNode(node->right.get(), value, split_node);
+    auto store = std::make_shared<PointStore<T>>();
+    store->coords = sealArray(std::move(coords), arena.get());
+    if (ragged) {
+        std::vector<uint32_t> widths(points.size());
+        for (size_t i = 0; i < points.size(); ++i) widths[i] = static_cast<uint32_t>(points[i].size());
+        store->widths = sealArray(std::move(widths), arena.get());
     }
+    store->backing = arena;
+    store->dims = stored_dims;
+    store->count = points.size();
+    store->first_axis = first_axis;
+    return store;
 }
 
-template<typename T>
-void RangeTree<T, 1>::collectPoints(const Node* node, std::vector<std::vector<T>>& result) const {
-    if (!node) return;
+// Copies a forward range of points into a store in one pass, spreading each over the columns
+template<typename T, size_t K, typename Iterator>
+std::shared_ptr<const PointStore<T>> makePointStore(Iterator first, Iterator last,
+                                                    const std::shared_ptr<Arena>& arena) {
+    const size_t count = static_cast<size_t>(std::distance(first, last));
+    std::vector<T> coords(count * K);
+    for (size_t i = 0; first != last; ++first, ++i) {
+        const std::array<T, K>& point = *first;
+        for (size_t d = 0; d < K; ++d) {
+            coords[d * count + i] = point[d];
+        }
+    }
     
-    // Add all points from this node's canonical subset
-    result.insert(result.end(), node->canonical_subset.begin(), node->canonical_subset.end());
+    auto store = std::make_shared<PointStore<T>>();
+    store->coords = sealArray(std::move(coords), arena.get());
+    store->backing = arena;
+    store->dims = K;
+    store->count = count;
+    store->first_axis = 0;
+    return store;
 }
 
-template<typename T>
-bool RangeTree<T, 1>::isPointInRange(const std::vector<T>& point, const T& low, const T& high) const {
-    return point[0] >= low && point[0] <= high;
+template<typename T, size_t K>
+std::shared_ptr<const PointStore<T>> makePointStore(const std::vector<std::array<T, K>>& points,
+                                                    const std::shared_ptr<Arena>& arena) {
+    return makePointStore<T, K>(points.begin(), points.end(), arena);
 }
 
+// Turns count rows of width values, stored one after another, into width columns of
+// count values without a second buffer, following each cycle of the permutation once
 template<typename T>
-void RangeTree<T, 1>::rangeSearchDim(
-    const Node* node, const T& low, const T& high, 
-    std::vector<std::vector<T>>& result) const {
-    
-    if (!node) return;
+void transposeRows(T* values, size_t count, size_t width) {
+    if (count < 2 || width < 2) return;
     
-    // If current node's value is outside the range
-    if (node->point[0] < low) {
-        rangeSearchDim(node->right.get(), low, high, result);
-        return;
+    const size_t total = count * width;
+    std::vector<bool> placed(total);
+    for (size_t start = 1; start + 1 < total; ++start) {
+        if (placed[start]) continue;
+        T carried = std::move(values[start]);
+        size_t at = start;
+        do {
+            // Value d of row i belongs at d * count + i
+            const size_t to = at % width * count + at / width;
+            std::swap(values[to], carried);
+            placed[to] = true;
+            at = to;
+        } while (at != start);
     }
-    
-    if (node->point[0] > high) {
-        rangeSearchDim(node->left.get(), low, high, result);
-        return;
+}
+
+// Takes over the buffer of the points as the store's columns; the store keeps it alive
+template<typename T, size_t K>
+std::shared_ptr<const PointStore<T>> makePointStore(std::vector<std::array<T, K>>&& points,
+                                                    const std::shared_ptr<Arena>& arena) {
+    if (arena) {
+        auto store = makePointStore<T, K>(points.begin(), points.end(), arena);
+        std::vector<std::array<T, K>>().swap(points);
+        return store;
     }
     
-    // Current node's point is in range
-    result.push_back(node->point);
+    static_assert(sizeof(std::array<T, K>) == K * sizeof(T), "Points must be packed to become columns");
+    auto owner = std::make_shared<std::vector<std::array<T, K>>>(std::move(points));
+    T* coords = owner->empty() ? nullptr : owner->front().data();
+    transposeRows(coords, owner->size(), K);
+    
+    auto store = std::make_shared<PointStore<T>>();
+    store->coords = FlatArray<T>::view(coords, owner->size() * K);
+    store->backing = owner;
+    store->dims = K;
+    store->count = owner->size();
+    store->first_axis = 0;
+    return store;
+}
+
+// Reads each record's coordinates through a projection, one column at a time
+template<typename T, typename Record, typename Projection>
+std::shared_ptr<const PointStore<T>> makeRecordStore(const std::vector<Record>& records, size_t axes,
+                                                     Projection& project, const std::shared_ptr<Arena>& arena) {
+    std::vector<T> coords(records.size() * axes);
+    for (size_t d = 0; d < axes; ++d) {
+        for (size_t i = 0; i < records.size(); ++i) {
+            coords[d * records.size() + i] = project(records[i], d);
+        }
+    }
     
-    // Check both subtrees
-    rangeSearchDim(node->left.get(), low, high, result);
-    rangeSearchDim(node->right.get(), low, high, result);
+    auto store = std::make_shared<PointStore<T>>();
+    store->coords = sealArray(std::move(coords), arena.get());
+    store->backing = arena;
+    store->dims = axes;
+    store->count = records.size();
+    store->first_axis = 0;
+    return store;
 }
 
+// Bound vectors of the compatibility API must cover every indexed dimension
 template<typename T>
-std::vector<std::vector<T>> RangeTree<T, 1>::rangeSearch(const std::vector<T>& low, const std::vector<T>& high) const {
-    if (low.size() < 1 || high.size() < 1) {
+void checkQueryDimensions(size_t low, size_t high, size_t dims) {
+    if (low < dims || high < dims) {
         throw std::invalid_argument("Range dimensions do not match tree dimension");
     }
+}
+
+// Header of an image: what the file holds, checked against the tree type opening it.
+// The point columns follow as one array of stored_dims * count coordinates, then the
+// width of every point, empty when they all have stored_dims.
+template<typename T>
+void writeImageFields(ImageWriter& image, size_t dims, size_t first_axis, const BuildOptions& options,
+                      size_t stored_dims) {
+    static_assert(std::is_trivially_copyable<T>::value, "Images store coordinates as raw bytes");
     
-    std::vector<std::vector<T>> result;
-    if (!root) return result;
-    
-    // Find results for 1D range
-    rangeSearchDim(root.get(), low[0], high[0], result);
-    
-    return result;
+    image.writeBytes(image_magic, sizeof(image_magic));
+    image.writeValue(3); // Format version
+    image.writeValue(sizeof(T));
+    image.writeValue(dims);
+    image.writeValue(first_axis);
+    image.writeValue(options.fractional_cascading ? 1 : 0);
+    image.writeValue(options.leaf_size);
+    image.writeValue(stored_dims);
 }
 
 template<typename T>
-bool RangeTree<T, 1>::search(const std::vector<T>& point) const {
-    if (point.size() < 1) {
-        throw std::invalid_argument("Point dimension does not match tree dimension");
-    }
+void writeImageHeader(ImageWriter& image, size_t dims, const BuildOptions& options,
+                      const PointStore<T>& store) {
+    writeImageFields<T>(image, dims, store.first_axis, options, store.dims);
+    image.writeArray(store.coords.data(), store.coords.size());
+    image.writeArray(store.widths.data(), store.widths.size());
+}
+
+template<typename T>
+std::shared_ptr<const PointStore<T>> readImageHeader(ImageReader& image, size_t dims, BuildOptions& options) {
+    static_assert(std::is_trivially_copyable<T>::value, "Images store coordinates as raw bytes");
     
-    // Create vector arguments for rangeSearch
-    std::vector<T> low = {point[0]};
-    std::vector<T> high = {point[0]};
+    if (std::memcmp(image.take(sizeof(image_magic)), image_magic, sizeof(image_magic)) != 0 ||
+        image.readValue() != 3) {
+        throw std::runtime_error("Not a range tree image");
+    }
+    if (image.readValue() != sizeof(T) || image.readValue() != dims) {
+        throw std::runtime_error("Range tree image does not match the tree type");
+    }
+    const size_t first_axis = image.readValue();
+    options.fractional_cascading = image.readValue() != 0;
+    options.leaf_size = image.readValue();
     
-    // Use range query with low = high = point's value
-    return !rangeSearch(low, high).empty();
-}
\ No newline at end of file
+    auto store = std::make_shared<PointStore<T>>();
+    store->dims = image.readValue();
+    store->coords = image.readArray<T>();
+    store->widths = image.readArray<uint32_t>();
+    store->backing = image.backing();
+    store->first_axis = first_axis;
+    if (store->dims < first_axis + dims || store->coords.size() % store->dims != 0) {
+        throw std::runtime_error("Range tree image is corrupt");
+    }
+    store->count = store->coords.size() / store->dims;
+    if (!store->widths.empty() && store->widths.size() != store->count) {
+        throw std::runtime_error("Range tree image is corrupt");
+    }
+    return store;
+}
+
+// Implementation for K-dimensional Range Tree
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+RangeTree<T, K, Compare, Axis>::RangeTree(const std::vector<std::vector<T>>& points, size_t dim)
+    : RangeTree(points, BuildOptions(), dim) {}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+RangeTree<T, K, Compare, Axis>::RangeTree(const std::vector<std::vector<T>>& points, const BuildOptions& opts, size_t dim)
+    : store(makePointStore(points, dim, K, opts.arena)), order(pointIndices(points.size())), options(opts) {
+    // The store is the only copy of the points; every level refers to it by index
+    if (!order.empty()) init();
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+RangeTree<T, K, Compare, Axis>::RangeTree(const std::vector<Point>& points, const BuildOptions& opts)
+    : store(makePointStore(points, opts.arena)), order(pointIndices(points.size())), options(opts) {
+    if (!order.empty()) init();
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+RangeTree<T, K, Compare, Axis>::RangeTree(std::vector<Point>&& points, const BuildOptions& opts)
+    : store(makePointStore(std::move(points), opts.arena)), order(pointIndices(store->size())), options(opts) {
+    if (!order.empty()) init();
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Iterator, typename>
+RangeTree<T, K, Compare, Axis>::RangeTree(Iterator first, Iterator last, const BuildOptions& opts)
+    : store(makePointStore<T, K>(first, last, opts.arena)), order(pointIndices(store->size())), options(opts) {
+    if (!order.empty()) init();
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Record, typename Projection, typename>
+RangeTree<T, K, Compare, Axis>::RangeTree(const std::vector<Record>& records, Projection project, const BuildOptions& opts)
+    : store(makeRecordStore<T>(records, K, project, opts.arena)), order(pointIndices(records.size())), options(opts) {
+    if (!order.empty()) init();
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+RangeTree<T, K, Compare, Axis>::RangeTree(std::shared_ptr<const PointStore<T>> points, std::vector<uint32_t> sorted,
+                           const std::vector<TreeRange>& trees, const BuildOptions& opts, BuildContext& context)
+    : store(std::move(points)), order(sealArray(std::move(sorted), opts.arena.get())), options(opts) {
+    buildForest(trees, context);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+RangeTree<T, K, Compare, Axis>::RangeTree(std::shared_ptr<const PointStore<T>> points, ImageReader& image,
+                           const BuildOptions& opts)
+    : store(std::move(points)), order(image.readArray<uint32_t>()), keys(image.readArray<T>()),
+      columns(image.readArray<T>()), options(opts) {
+    const bool bucketed = options.leaf_size > 0 && !isCascading() && !order.empty();
+    if (order.size() != store->size() || keys.size() != order.size() ||
+        columns.size() != (bucketed ? K * order.size() : 0)) {
+        throw std::runtime_error("Range tree image is corrupt");
+    }
+    
+    // Views of the mapped arrays, in the order saveLevel wrote them
+    const uint64_t depths = image.readValue();
+    for (uint64_t depth = 0; depth < depths; ++depth) {
+        cascade.push_back(image.readArray<uint32_t>());
+        left_bridge.push_back(image.readArray<uint32_t>());
+        right_bridge.push_back(image.readArray<uint32_t>());
+    }
+    const uint64_t levels = image.readValue();
+    for (uint64_t level = 0; level < levels; ++level) {
+        next_level.push_back(RangeTree<T, K-1, Compare, Axis+1>(store, image, options));
+    }
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+TreeStats RangeTree<T, K, Compare, Axis>::stats() const {
+    TreeStats stats;
+    stats.points = store->size();
+    stats.point_bytes = store->coords.size() * sizeof(T);
+    stats.levels.resize(Axis + K);
+    if (!order.empty()) addStats({TreeRange{0, static_cast<uint32_t>(order.size())}}, stats);
+    return stats;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::addStats(const std::vector<TreeRange>& trees, TreeStats& stats) const {
+    LevelStats& level = stats.levels[Axis];
+    ++level.forests;
+    level.trees += trees.size();
+    level.references += order.size();
+    addTreeShapes(trees, level);
+    level.order_bytes += order.size() * sizeof(uint32_t);
+    level.key_bytes += keys.size() * sizeof(T);
+    level.bucket_bytes += columns.size() * sizeof(T);
+    for (size_t depth = 0; depth < cascade.size(); ++depth) {
+        level.cascade_bytes += (cascade[depth].size() + left_bridge[depth].size() + right_bridge[depth].size()) *
+                               sizeof(uint32_t);
+    }
+    
+    // Associated forest d holds the subtrees of the nodes at depth d
+    if (next_level.empty()) return;
+    const std::vector<std::vector<TreeRange>> depths = rangesByDepth(trees);
+    for (size_t depth = 0; depth < next_level.size(); ++depth) {
+        next_level[depth].addStats(depths[depth], stats);
+    }
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::save(const std::string& path) const {
+    ImageWriter image(path);
+    writeImageHeader(image, K, options, *store);
+    saveLevel(image);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+RangeTree<T, K, Compare, Axis> RangeTree<T, K, Compare, Axis>::open(const std::string& path) {
+    ImageReader image(path);
+    BuildOptions opts;
+    std::shared_ptr<const PointStore<T>> points = readImageHeader<T>(image, K, opts);
+    return RangeTree(std::move(points), image, opts);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::saveLevel(ImageWriter& image) const {
+    image.writeArray(order.data(), order.size());
+    image.writeArray(keys.data(), keys.size());
+    image.writeArray(columns.data(), columns.size());
+    image.writeValue(cascade.size());
+    for (size_t depth = 0; depth < cascade.size(); ++depth) {
+        image.writeArray(cascade[depth].data(), cascade[depth].size());
+        image.writeArray(left_bridge[depth].data(), left_bridge[depth].size());
+        image.writeArray(right_bridge[depth].data(), right_bridge[depth].size());
+    }
+    image.writeValue(next_level.size());
+    for (const RangeTree<T, K-1, Compare, Axis+1>& level : next_level) {
+        level.saveLevel(image);
+    }
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::init() {
+    // The only comparison sorts of the build: point indices once per dimension.
+    // Every associated level is split out of these lists in linear time.
+    const PointStore<T>& points = *store;
+    BuildContext context(options);
+    context.presorted.resize(Axis + K);
+    std::vector<std::future<void>> sorts;
+    for (size_t axis = Axis; axis < Axis + K; ++axis) {
+        std::vector<uint32_t>& sorted = context.presorted[axis];
+        sorted.assign(order.begin(), order.end());
+        const T* column = points.axis(axis);
+        sorts.push_back(context.spawn([column, &sorted]() {
+            std::sort(sorted.begin(), sorted.end(),
+                      [column](uint32_t a, uint32_t b) { return Compare()(column[a], column[b]); });
+        }));
+    }
+    for (std::future<void>& sort : sorts) sort.get();
+    order = sealArray(context.presorted[Axis], options.arena.get());
+    
+    // Build the tree: a forest holding a single tree
+    buildForest({{0, static_cast<uint32_t>(order.size())}}, context);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::buildForest(const std::vector<TreeRange>& trees, BuildContext& context) {
+    std::vector<T> values(order.size());
+    for (const TreeRange& tree : trees) {
+        fillKeys(TreeCursor::root(tree.begin, tree.end), tree.begin, values);
+    }
+    keys = sealArray(std::move(values), options.arena.get());
+    
+    const std::vector<std::vector<TreeRange>> depths = rangesByDepth(trees);
+    if (isCascading()) {
+        // Last two dimensions: link each node's subset to its children's instead of building 1D trees
+        buildCascade(depths);
+        return;
+    }
+    
+    if (options.leaf_size > 0) {
+        std::vector<T> values(K * order.size());
+        for (size_t d = 0; d < K; ++d) {
+            for (size_t i = 0; i < order.size(); ++i) {
+                values[d * order.size() + i] = coord(order[i], Axis + d);
+            }
+        }
+        columns = sealArray(std::move(values), options.arena.get());
+    }
+    
+    // Depths below the last one holding a subtree larger than a bucket are never searched
+    size_t searched = depths.size();
+    while (searched > 0 && std::all_of(depths[searched - 1].begin(), depths[searched - 1].end(),
+                                       [this](const TreeRange& range) {
+                                           return range.end - range.begin <= options.leaf_size;
+                                       })) {
+        --searched;
+    }
+    
+    // Position of every point in this level
+    std::vector<uint32_t> position(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        position[order[i]] = static_cast<uint32_t>(i);
+    }
+    
+    // Roots: route the points, in next-dimension order, to the tree holding them.
+    // Positions outside every tree are never queried and keep their own point.
+    const uint32_t none = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> tree_of(order.size(), none);
+    std::vector<uint32_t> fill(trees.size());
+    for (size_t t = 0; t < trees.size(); ++t) {
+        std::fill(tree_of.begin() + trees[t].begin, tree_of.begin() + trees[t].end, static_cast<uint32_t>(t));
+        fill[t] = trees[t].begin;
+    }
+    std::vector<uint32_t> sorted(order.begin(), order.end());
+    for (uint32_t point : context.presorted[Axis + 1]) {
+        const uint32_t tree = tree_of[position[point]];
+        if (tree != none) sorted[fill[tree]++] = point;
+    }
+    
+    // One associated forest per depth, holding the subtrees of all nodes at that depth.
+    // The next depth's lists are a stable split of each node's list around the node.
+    // The forests are independent, so large ones are built as tasks into fixed slots.
+    std::vector<std::unique_ptr<RangeTree<T, K-1, Compare, Axis+1>>> levels(searched);
+    std::vector<std::future<void>> tasks;
+    for (size_t depth = 0; depth < searched; ++depth) {
+        const std::vector<TreeRange>& nodes = depths[depth];
+        std::vector<uint32_t> children = sorted;
+        for (const TreeRange& range : nodes) {
+            const TreeCursor node = TreeCursor::root(range.begin, range.end);
+            uint32_t left = node.begin, right = node.mid + 1;
+            for (uint32_t i = node.begin; i < node.end; ++i) {
+                const uint32_t point = sorted[i];
+                if (position[point] < node.mid) {
+                    children[left++] = point;
+                } else if (position[point] > node.mid) {
+                    children[right++] = point;
+                }
+            }
+            children[node.mid] = order[node.mid];
+        }
+        
+        std::unique_ptr<RangeTree<T, K-1, Compare, Axis+1>>& level = levels[depth];
+        auto build = [this, &level, &nodes, &context](std::vector<uint32_t>& indices) {
+            level.reset(new RangeTree<T, K-1, Compare, Axis+1>(store, std::move(indices), nodes, options, context));
+        };
+        if (order.size() >= options.parallel_cutoff) {
+            tasks.push_back(context.spawn([build, indices = std::move(sorted)]() mutable { build(indices); }));
+        } else {
+            build(sorted);
+        }
+        sorted = std::move(children);
+    }
+    
+    for (std::future<void>& task : tasks) task.get();
+    next_level.reserve(levels.size());
+    for (std::unique_ptr<RangeTree<T, K-1, Compare, Axis+1>>& level : levels) {
+        next_level.push_back(std::move(*level));
+    }
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::fillKeys(const TreeCursor& node, uint32_t tree_begin, std::vector<T>& values) const {
+    if (node.empty()) return;
+    
+    values[tree_begin + node.index] = coord(order[node.mid], Axis);
+    fillKeys(node.left(), tree_begin, values);
+    fillKeys(node.right(), tree_begin, values);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::buildCascade(const std::vector<std::vector<TreeRange>>& depths) {
+    const T* next = store->axis(Axis + 1);
+    auto by_next = [next](uint32_t a, uint32_t b) { return Compare()(next[a], next[b]); };
+    
+    std::vector<std::vector<uint32_t>> subsets(depths.size(), std::vector<uint32_t>(order.size()));
+    std::vector<std::vector<uint32_t>> lefts(depths.size(), std::vector<uint32_t>(order.size()));
+    std::vector<std::vector<uint32_t>> rights(depths.size(), std::vector<uint32_t>(order.size()));
+    
+    // Bottom-up: children are already sorted one depth below
+    for (size_t depth = depths.size(); depth-- > 0;) {
+        for (const TreeRange& range : depths[depth]) {
+            const TreeCursor node = TreeCursor::root(range.begin, range.end);
+            uint32_t* subset = &subsets[depth][node.begin];
+            
+            if (node.end - node.begin == 1) {
+                *subset = order[node.mid];
+                lefts[depth][node.mid] = node.mid;
+                rights[depth][node.mid] = node.end;
+                continue;
+            }
+            
+            // Merge the children and slot in the node's own point
+            const std::vector<uint32_t>& below = subsets[depth + 1];
+            uint32_t* merged_end = std::merge(below.begin() + node.begin, below.begin() + node.mid,
+                                              below.begin() + node.mid + 1, below.begin() + node.end,
+                                              subset, by_next);
+            uint32_t* slot = std::upper_bound(subset, merged_end, order[node.mid], by_next);
+            std::copy_backward(slot, merged_end, merged_end + 1);
+            *slot = order[node.mid];
+            
+            // Merge walk for the bridges, as absolute positions one depth below
+            size_t l = node.begin, r = node.mid + 1;
+            for (size_t i = node.begin; i < node.end; ++i) {
+                const T& value = next[subsets[depth][i]];
+                while (l < node.mid && less(next[below[l]], value)) ++l;
+                while (r < node.end && less(next[below[r]], value)) ++r;
+                lefts[depth][i] = static_cast<uint32_t>(l);
+                rights[depth][i] = static_cast<uint32_t>(r);
+            }
+        }
+    }
+    
+    for (size_t depth = 0; depth < depths.size(); ++depth) {
+        cascade.push_back(sealArray(std::move(subsets[depth]), options.arena.get()));
+        left_bridge.push_back(sealArray(std::move(lefts[depth]), options.arena.get()));
+        right_bridge.push_back(sealArray(std::move(rights[depth]), options.arena.get()));
+    }
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+TreeCursor RangeTree<T, K, Compare, Axis>::findSplitNode(uint32_t begin, uint32_t end, const T& low, const T& high) const {
+    // Walk down until the search paths for low and high diverge,
+    // i.e. the first node whose value lies inside [low, high]
+    TreeCursor node = TreeCursor::root(begin, end);
+    while (!node.empty()) {
+        RANGE_TREE_COUNT(nodes_visited, 1);
+        const T& key = keys[begin + node.index];
+        if (less(key, low)) {
+            node = node.right();
+        } else if (less(high, key)) {
+            node = node.left();
+        } else {
+            break;
+        }
+    }
+    return node;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+bool RangeTree<T, K, Compare, Axis>::isPointInRange(uint32_t point, const T* low, const T* high) const {
+    // Nodes reported by the descent already lie inside the range of the current
+    // dimension, so only the dimensions below this level are left to check
+    RANGE_TREE_COUNT(points_tested, 1);
+    return AxesInside<Axis + 1, Axis + K>::check(*store, point, low, high, Compare());
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+bool RangeTree<T, K, Compare, Axis>::scanBucket(const TreeCursor& node, size_t from, const T* low, const T* high, Sink& sink) const {
+    // Columns [0, from) are already known to hold for the whole bucket
+    RANGE_TREE_COUNT(bucket_scans, 1);
+    RANGE_TREE_COUNT(bucket_points, node.end - node.begin);
+    for (uint32_t first = node.begin; first < node.end; first += 64) {
+        const size_t count = std::min<size_t>(64, node.end - first);
+        uint64_t mask = bucketMask(columns.data(), order.size(), from, K, first, count,
+                                   low + Axis, high + Axis, Compare());
+        for (; mask; mask &= mask - 1) {
+            if (!reportPoint(sink, order[first + lowestBit(mask)])) return false;
+        }
+    }
+    return true;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+bool RangeTree<T, K, Compare, Axis>::searchCovered(const TreeCursor& covered, const T* low, const T* high, Sink& sink,
+                                                   uint64_t free) const {
+    if (covered.empty()) return true;
+    RANGE_TREE_COUNT(canonical_subtrees, 1);
+    const uint64_t below = lowBits(K - 1) << (Axis + 1);
+    if ((free & below) == below) return reportSlice(sink, order.data() + covered.begin, order.data() + covered.end);
+    if (isBucket(covered)) return scanBucket(covered, 1, low, high, sink);
+    return next_level[covered.depth].rangeSearchDim(covered.begin, covered.end, low, high, sink, free);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+bool RangeTree<T, K, Compare, Axis>::rangeSearchDim(uint32_t begin, uint32_t end, const T* low, const T* high, Sink& sink,
+                                                    uint64_t free) const {
+    // Bounds of free axes are extremes that never exclude a point: a tree free in every
+    // remaining axis is reported whole, and one free in this axis is covered by its root
+    const uint64_t remaining = lowBits(K) << Axis;
+    if ((free & remaining) == remaining) return reportSlice(sink, order.data() + begin, order.data() + end);
+    if (isCascading()) {
+        return rangeSearchCascading(begin, end, low, high, sink, free);
+    }
+    if (free >> Axis & 1) return searchCovered(TreeCursor::root(begin, end), low, high, sink, free);
+    
+    const T& lo = low[Axis];
+    const T& hi = high[Axis];
+    
+    const TreeCursor split = findSplitNode(begin, end, lo, hi);
+    if (split.empty()) return true;
+    if (isBucket(split)) return scanBucket(split, 0, low, high, sink);
+    
+    if (isPointInRange(order[split.mid], low, high) && !reportPoint(sink, order[split.mid])) {
+        return false;
+    }
+    
+    // Left boundary path: every right subtree hanging off it lies inside [lo, hi]
+    // in the current dimension, so its associated tree answers the remaining ones.
+    // A path that reaches a bucket filters it in every dimension and stops there.
+    TreeCursor node = split.left();
+    while (!node.empty()) {
+        if (isBucket(node)) {
+            if (!scanBucket(node, 0, low, high, sink)) return false;
+            break;
+        }
+        RANGE_TREE_COUNT(nodes_visited, 1);
+        if (less(keys[begin + node.index], lo)) {
+            node = node.right();
+            continue;
+        }
+        if (isPointInRange(order[node.mid], low, high) && !reportPoint(sink, order[node.mid])) {
+            return false;
+        }
+        if (!searchCovered(node.right(), low, high, sink, free)) return false;
+        node = node.left();
+    }
+    
+    // Right boundary path, mirrored
+    node = split.right();
+    while (!node.empty()) {
+        if (isBucket(node)) return scanBucket(node, 0, low, high, sink);
+        RANGE_TREE_COUNT(nodes_visited, 1);
+        if (less(hi, keys[begin + node.index])) {
+            node = node.left();
+            continue;
+        }
+        if (isPointInRange(order[node.mid], low, high) && !reportPoint(sink, order[node.mid])) {
+            return false;
+        }
+        if (!searchCovered(node.left(), low, high, sink, free)) return false;
+        node = node.right();
+    }
+    return true;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+TreeCursor RangeTree<T, K, Compare, Axis>::cascadeChild(const TreeCursor& node, bool left, size_t& first, size_t& last) const {
+    const TreeCursor child = left ? node.left() : node.right();
+    if (child.empty()) return child;
+    
+    // Maps [first, last) of the node onto the child; the node's end has no bridge entry
+    const FlatArray<uint32_t>& bridge = left ? left_bridge[node.depth] : right_bridge[node.depth];
+    first = first < node.end ? bridge[first] : child.end;
+    last = last < node.end ? bridge[last] : child.end;
+    return child;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+bool RangeTree<T, K, Compare, Axis>::rangeSearchCascading(uint32_t begin, uint32_t end, const T* low, const T* high,
+                                                          Sink& sink, uint64_t free) const {
+    const T& lo = low[Axis];
+    const T& hi = high[Axis];
+    const size_t next = Axis + 1;
+    const T* column = store->axis(next);
+    
+    // A free axis leaves the root covered: its subset answers the next axis alone
+    const bool covered = free >> Axis & 1;
+    const TreeCursor split = covered ? TreeCursor::root(begin, end) : findSplitNode(begin, end, lo, hi);
+    if (split.empty()) return true;
+    
+    // The only binary search of the query: locate the next-dimension range in the
+    // split node's subset, then follow bridges down both boundary paths
+    const uint32_t* subset = cascade[split.depth].data();
+    size_t first = std::lower_bound(subset + split.begin, subset + split.end, low[next],
+                                    [column](uint32_t p, const T& v) { return less(column[p], v); }) - subset;
+    size_t last = std::upper_bound(subset + split.begin, subset + split.end, high[next],
+                                   [column](const T& v, uint32_t p) { return less(v, column[p]); }) - subset;
+    if (first >= last) return true;
+    if (covered) return reportSlice(sink, subset + first, subset + last);
+    
+    if (isPointInRange(order[split.mid], low, high) && !reportPoint(sink, order[split.mid])) {
+        return false;
+    }
+    
+    // Left boundary path first, then the mirrored right one
+    for (int side = 0; side < 2; ++side) {
+        const bool left_path = side == 0;
+        size_t node_first = first, node_last = last;
+        TreeCursor node = cascadeChild(split, left_path, node_first, node_last);
+        
+        while (!node.empty() && node_first < node_last) {
+            RANGE_TREE_COUNT(nodes_visited, 1);
+            const T& key = keys[begin + node.index];
+            if (left_path ? less(key, lo) : less(hi, key)) {
+                // Step back towards the range without reporting anything
+                node = cascadeChild(node, !left_path, node_first, node_last);
+                continue;
+            }
+            
+            if (isPointInRange(order[node.mid], low, high) && !reportPoint(sink, order[node.mid])) {
+                return false;
+            }
+            
+            // The inner subtree is covered in the current dimension: report its slice as is
+            size_t covered_first = node_first, covered_last = node_last;
+            const TreeCursor covered = cascadeChild(node, !left_path, covered_first, covered_last);
+            if (!covered.empty()) {
+                RANGE_TREE_COUNT(canonical_subtrees, 1);
+                const uint32_t* slice = cascade[covered.depth].data();
+                if (!reportSlice(sink, slice + covered_first, slice + covered_last)) return false;
+            }
+            
+            node = cascadeChild(node, left_path, node_first, node_last);
+        }
+    }
+    return true;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+void RangeTree<T, K, Compare, Axis>::rangeSearchBatchDim(uint32_t begin, uint32_t end, const QueryBounds<T>* bounds,
+                                          uint32_t* queries, size_t count, Sink& sink) const {
+    if (isCascading()) {
+        // Bridges are followed query by query; the split search is a single descent anyway
+        for (size_t i = 0; i < count; ++i) {
+            SingleQuery<Sink> single{sink, queries[i]};
+            rangeSearchCascading(begin, end, bounds[queries[i]].low, bounds[queries[i]].high, single, 0);
+        }
+        return;
+    }
+    batchSplit(TreeCursor::root(begin, end), begin, bounds, queries, count, sink);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+void RangeTree<T, K, Compare, Axis>::batchSplit(const TreeCursor& node, uint32_t tree_begin, const QueryBounds<T>* bounds,
+                                 uint32_t* queries, size_t count, Sink& sink) const {
+    if (node.empty() || count == 0) return;
+    if (isBucket(node)) {
+        batchBucket(node, 0, bounds, queries, count, sink);
+        return;
+    }
+    
+    // Queries still heading right, still heading left, and those splitting here
+    const T& key = keys[tree_begin + node.index];
+    const size_t dim = Axis;
+    uint32_t* last = queries + count;
+    uint32_t* left = std::partition(queries, last, [&](uint32_t q) { return less(key, bounds[q].low[dim]); });
+    uint32_t* split = std::partition(left, last, [&](uint32_t q) { return less(bounds[q].high[dim], key); });
+    
+    batchSplit(node.right(), tree_begin, bounds, queries, left - queries, sink);
+    batchSplit(node.left(), tree_begin, bounds, left, split - left, sink);
+    if (split == last) return;
+    
+    for (uint32_t* q = split; q != last; ++q) {
+        if (isPointInRange(order[node.mid], bounds[*q].low, bounds[*q].high)) sink.point(*q, order[node.mid]);
+    }
+    batchPath(node.left(), true, tree_begin, bounds, split, last - split, sink);
+    batchPath(node.right(), false, tree_begin, bounds, split, last - split, sink);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+void RangeTree<T, K, Compare, Axis>::batchPath(TreeCursor node, bool left_path, uint32_t tree_begin, const QueryBounds<T>* bounds,
+                                uint32_t* queries, size_t count, Sink& sink) const {
+    const size_t dim = Axis;
+    while (!node.empty() && count > 0) {
+        if (isBucket(node)) {
+            batchBucket(node, 0, bounds, queries, count, sink);
+            return;
+        }
+        
+        // Queries whose boundary runs through this node report it and its inner subtree,
+        // the others step back towards their range
+        const T& key = keys[tree_begin + node.index];
+        uint32_t* away = std::partition(queries, queries + count, [&](uint32_t q) {
+            return left_path ? !less(key, bounds[q].low[dim]) : !less(bounds[q].high[dim], key);
+        });
+        const size_t on_path = away - queries;
+        batchPath(left_path ? node.right() : node.left(), left_path, tree_begin, bounds, away, count - on_path, sink);
+        
+        for (uint32_t* q = queries; q != away; ++q) {
+            if (isPointInRange(order[node.mid], bounds[*q].low, bounds[*q].high)) sink.point(*q, order[node.mid]);
+        }
+        const TreeCursor covered = left_path ? node.right() : node.left();
+        if (!covered.empty() && on_path > 0) {
+            if (isBucket(covered)) {
+                batchBucket(covered, 1, bounds, queries, on_path, sink);
+            } else {
+                next_level[covered.depth].rangeSearchBatchDim(covered.begin, covered.end, bounds, queries, on_path, sink);
+            }
+        }
+        
+        node = left_path ? node.left() : node.right();
+        count = on_path;
+    }
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+void RangeTree<T, K, Compare, Axis>::batchBucket(const TreeCursor& node, size_t from, const QueryBounds<T>* bounds,
+                                  const uint32_t* queries, size_t count, Sink& sink) const {
+    for (size_t i = 0; i < count; ++i) {
+        SingleQuery<Sink> single{sink, queries[i]};
+        scanBucket(node, from, bounds[queries[i]].low, bounds[queries[i]].high, single);
+    }
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<typename RangeTree<T, K, Compare, Axis>::Point> RangeTree<T, K, Compare, Axis>::rangeSearch(const Point& low, const Point& high) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    // Canonical decomposition over this dimension, remaining ones via next_level
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), collect);
+    
+    std::vector<Point> result(indices.size());
+    for (size_t d = 0; d < K; ++d) {
+        const T* column = store->column(d);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            result[i][d] = column[indices[i]];
+        }
+    }
+    return result;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<std::vector<T>> RangeTree<T, K, Compare, Axis>::rangeSearch(
+    const std::vector<T>& low, const std::vector<T>& high) const {
+    
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + K);
+    
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), collect);
+    
+    return gatherRows(*store, indices);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<std::vector<T>> RangeTree<T, K, Compare, Axis>::rangeSearch(
+    std::initializer_list<T> low, std::initializer_list<T> high) const {
+    
+    return rangeSearch(std::vector<T>(low), std::vector<T>(high));
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<uint32_t> RangeTree<T, K, Compare, Axis>::rangeSearchIndices(const Point& low, const Point& high) const {
+    std::vector<uint32_t> indices;
+    rangeSearchInto(low, high, indices);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+void RangeTree<T, K, Compare, Axis>::rangeSearchInto(const Point& low, const Point& high, std::vector<uint32_t>& indices) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), collect);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<uint32_t> RangeTree<T, K, Compare, Axis>::rangeSearchIndices(const std::vector<T>& low, const std::vector<T>& high) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + K);
+    
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), collect);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<std::vector<T>> RangeTree<T, K, Compare, Axis>::rangeSearchColumns(const std::vector<T>& low, const std::vector<T>& high,
+                                                                const std::vector<size_t>& dims) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + K);
+    
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), collect);
+    return gatherColumns(*store, indices, dims);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, K, Compare, Axis>::rangeSearch(const Point& low, const Point& high, Visitor&& visit) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    VisitPoints<T, typename std::remove_reference<Visitor>::type, K> visitor(*store, visit);
+    return rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), visitor);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, K, Compare, Axis>::rangeSearch(const std::vector<T>& low, const std::vector<T>& high, Visitor&& visit) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + K);
+    
+    VisitPoints<T, typename std::remove_reference<Visitor>::type, K> visitor(*store, visit);
+    return rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), visitor);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, K, Compare, Axis>::rangeSearch(std::initializer_list<T> low, std::initializer_list<T> high, Visitor&& visit) const {
+    return rangeSearch(std::vector<T>(low), std::vector<T>(high), std::forward<Visitor>(visit));
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+size_t RangeTree<T, K, Compare, Axis>::rangeCount(const Point& low, const Point& high) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    CountPoints counter{0};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), counter);
+    return counter.count;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+size_t RangeTree<T, K, Compare, Axis>::rangeCount(const std::vector<T>& low, const std::vector<T>& high) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + K);
+    
+    CountPoints counter{0};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), counter);
+    return counter.count;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+size_t RangeTree<T, K, Compare, Axis>::rangeCount(std::initializer_list<T> low, std::initializer_list<T> high) const {
+    return rangeCount(std::vector<T>(low), std::vector<T>(high));
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+bool RangeTree<T, K, Compare, Axis>::containsPoint(const T* point) const {
+    // Points equal in the current dimension form one run of the sorted order
+    const uint32_t size = static_cast<uint32_t>(order.size());
+    const uint32_t first = lowerBound(keys.data(), 0, size, point[Axis], Compare());
+    const uint32_t last = upperBound(keys.data(), 0, size, point[Axis], Compare());
+    
+    // Short runs are scanned directly, long runs of duplicates go through the
+    // decomposition of the degenerate box, stopping at the first hit
+    const uint32_t scan_limit = 32;
+    if (last - first > scan_limit) {
+        FindAny finder{false};
+        rangeSearchDim(0, size, point, point, finder);
+        return finder.found;
+    }
+    
+    for (uint32_t i = first; i < last; ++i) {
+        if (AxesInside<Axis + 1, Axis + K>::equal(*store, order[i], point, Compare())) return true;
+    }
+    return false;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Sink>
+bool RangeTree<T, K, Compare, Axis>::searchBox(const QueryBox<T, K>& box, Sink& sink) const {
+    const ClosedBox<T, K> closed = closeBox<T, Compare>(box);
+    if (closed.empty) return true;
+    return rangeSearchDim(0, static_cast<uint32_t>(order.size()), closed.low.data(), closed.high.data(), sink,
+                          closed.free);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<typename RangeTree<T, K, Compare, Axis>::Point> RangeTree<T, K, Compare, Axis>::rangeSearch(const QueryBox<T, K>& box) const {
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    searchBox(box, collect);
+    
+    std::vector<Point> result(indices.size());
+    for (size_t d = 0; d < K; ++d) {
+        const T* column = store->axis(d);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            result[i][d] = column[indices[i]];
+        }
+    }
+    return result;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<uint32_t> RangeTree<T, K, Compare, Axis>::rangeSearchIndices(const QueryBox<T, K>& box) const {
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    searchBox(box, collect);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+size_t RangeTree<T, K, Compare, Axis>::rangeCount(const QueryBox<T, K>& box) const {
+    CountPoints counter{0};
+    searchBox(box, counter);
+    return counter.count;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, K, Compare, Axis>::rangeSearch(const QueryBox<T, K>& box, Visitor&& visit) const {
+    VisitPoints<T, typename std::remove_reference<Visitor>::type, K> visitor(*store, visit);
+    return searchBox(box, visitor);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+bool RangeTree<T, K, Compare, Axis>::search(const Point& point) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    return containsPoint(point.data());
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+bool RangeTree<T, K, Compare, Axis>::search(const std::vector<T>& point) const {
+    if (point.size() < store->first_axis + K) {
+        throw std::invalid_argument("Point dimension does not match tree dimension");
+    }
+    return containsPoint(axes(point));
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+bool RangeTree<T, K, Compare, Axis>::search(std::initializer_list<T> point) const {
+    return search(std::vector<T>(point));
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<bool> RangeTree<T, K, Compare, Axis>::contains(const std::vector<Point>& points) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    // Neighbouring queries then share the top of every descent in cache
+    std::vector<uint32_t> batch = pointIndices(points.size());
+    std::sort(batch.begin(), batch.end(),
+              [&points](uint32_t a, uint32_t b) { return less(points[a][0], points[b][0]); });
+    
+    std::vector<bool> found(points.size());
+    for (uint32_t query : batch) {
+        found[query] = containsPoint(points[query].data());
+    }
+    return found;
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+template<typename Boxes, typename Sink>
+void RangeTree<T, K, Compare, Axis>::runBatch(const Boxes& boxes, Sink& sink) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    std::vector<QueryBounds<T>> bounds(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        bounds[i] = {boxes[i].low.data(), boxes[i].high.data()};
+    }
+    std::vector<uint32_t> queries = pointIndices(boxes.size());
+    rangeSearchBatchDim(0, static_cast<uint32_t>(order.size()), bounds.data(), queries.data(), queries.size(), sink);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+BatchResult RangeTree<T, K, Compare, Axis>::rangeSearchBatch(const std::vector<Box>& boxes) const {
+    // One traversal appends each query's hits to its own buffer, then they are packed
+    std::vector<std::vector<uint32_t>> hits(boxes.size());
+    CollectBatch collect{hits.data()};
+    runBatch(boxes, collect);
+    return packBatch(hits);
+}
+
+template<typename T, size_t K, typename Compare, size_t Axis>
+std::vector<size_t> RangeTree<T, K, Compare, Axis>::rangeCountBatch(const std::vector<Box>& boxes) const {
+    std::vector<size_t> counts(boxes.size());
+    CountBatch counter{counts.data()};
+    runBatch(boxes, counter);
+    return counts;
+}
+
+// Implementation for 1D Range Tree
+
+template<typename T, typename Compare, size_t Axis>
+RangeTree<T, 1, Compare, Axis>::RangeTree(const std::vector<std::vector<T>>& points, size_t dim)
+    : RangeTree(points, BuildOptions(), dim) {}
+
+// Layout options only change the levels above the last dimension
+template<typename T, typename Compare, size_t Axis>
+RangeTree<T, 1, Compare, Axis>::RangeTree(const std::vector<std::vector<T>>& points, const BuildOptions& opts, size_t dim)
+    : store(makePointStore(points, dim, 1, opts.arena)), order(pointIndices(points.size())) {
+    if (!order.empty()) init(opts.arena.get());
+}
+
+template<typename T, typename Compare, size_t Axis>
+RangeTree<T, 1, Compare, Axis>::RangeTree(const std::vector<Point>& points, const BuildOptions& opts)
+    : store(makePointStore(points, opts.arena)), order(pointIndices(points.size())) {
+    if (!order.empty()) init(opts.arena.get());
+}
+
+template<typename T, typename Compare, size_t Axis>
+RangeTree<T, 1, Compare, Axis>::RangeTree(std::vector<Point>&& points, const BuildOptions& opts)
+    : store(makePointStore(std::move(points), opts.arena)), order(pointIndices(store->size())) {
+    if (!order.empty()) init(opts.arena.get());
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Iterator, typename>
+RangeTree<T, 1, Compare, Axis>::RangeTree(Iterator first, Iterator last, const BuildOptions& opts)
+    : store(makePointStore<T, 1>(first, last, opts.arena)), order(pointIndices(store->size())) {
+    if (!order.empty()) init(opts.arena.get());
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Record, typename Projection, typename>
+RangeTree<T, 1, Compare, Axis>::RangeTree(const std::vector<Record>& records, Projection project, const BuildOptions& opts)
+    : store(makeRecordStore<T>(records, 1, project, opts.arena)), order(pointIndices(records.size())) {
+    if (!order.empty()) init(opts.arena.get());
+}
+
+template<typename T, typename Compare, size_t Axis>
+RangeTree<T, 1, Compare, Axis>::RangeTree(std::shared_ptr<const PointStore<T>> points, std::vector<uint32_t> sorted,
+                           const std::vector<TreeRange>& trees, const BuildOptions& opts, BuildContext&)
+    : store(std::move(points)), order(sealArray(std::move(sorted), opts.arena.get())) {
+    buildForest(trees, opts.arena.get());
+}
+
+template<typename T, typename Compare, size_t Axis>
+RangeTree<T, 1, Compare, Axis>::RangeTree(std::shared_ptr<const PointStore<T>> points, ImageReader& image,
+                           const BuildOptions&)
+    : store(std::move(points)), order(image.readArray<uint32_t>()), keys(image.readArray<T>()) {
+    if (order.size() != store->size() || keys.size() != order.size()) {
+        throw std::runtime_error("Range tree image is corrupt");
+    }
+}
+
+template<typename T, typename Compare, size_t Axis>
+TreeStats RangeTree<T, 1, Compare, Axis>::stats() const {
+    TreeStats stats;
+    stats.points = store->size();
+    stats.point_bytes = store->coords.size() * sizeof(T);
+    stats.levels.resize(Axis + 1);
+    if (!order.empty()) addStats({TreeRange{0, static_cast<uint32_t>(order.size())}}, stats);
+    return stats;
+}
+
+template<typename T, typename Compare, size_t Axis>
+void RangeTree<T, 1, Compare, Axis>::addStats(const std::vector<TreeRange>& trees, TreeStats& stats) const {
+    LevelStats& level = stats.levels[Axis];
+    ++level.forests;
+    level.trees += trees.size();
+    level.references += order.size();
+    addTreeShapes(trees, level);
+    level.order_bytes += order.size() * sizeof(uint32_t);
+    level.key_bytes += keys.size() * sizeof(T);
+}
+
+template<typename T, typename Compare, size_t Axis>
+void RangeTree<T, 1, Compare, Axis>::save(const std::string& path) const {
+    ImageWriter image(path);
+    writeImageHeader(image, 1, BuildOptions(), *store);
+    saveLevel(image);
+}
+
+template<typename T, typename Compare, size_t Axis>
+RangeTree<T, 1, Compare, Axis> RangeTree<T, 1, Compare, Axis>::open(const std::string& path) {
+    ImageReader image(path);
+    BuildOptions opts;
+    std::shared_ptr<const PointStore<T>> points = readImageHeader<T>(image, 1, opts);
+    return RangeTree(std::move(points), image, opts);
+}
+
+template<typename T, typename Compare, size_t Axis>
+void RangeTree<T, 1, Compare, Axis>::saveLevel(ImageWriter& image) const {
+    image.writeArray(order.data(), order.size());
+    image.writeArray(keys.data(), keys.size());
+}
+
+template<typename T, typename Compare, size_t Axis>
+void RangeTree<T, 1, Compare, Axis>::init(Arena* arena) {
+    // Sort point indices by the single dimension
+    const T* column = store->axis(Axis);
+    std::vector<uint32_t> sorted(order.begin(), order.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [column](uint32_t a, uint32_t b) { return Compare()(column[a], column[b]); });
+    order = sealArray(std::move(sorted), arena);
+    
+    // Build the tree
+    buildForest({{0, static_cast<uint32_t>(order.size())}}, arena);
+}
+
+template<typename T, typename Compare, size_t Axis>
+void RangeTree<T, 1, Compare, Axis>::buildForest(const std::vector<TreeRange>& trees, Arena* arena) {
+    std::vector<T> values(order.size());
+    for (const TreeRange& tree : trees) {
+        fillKeys(TreeCursor::root(tree.begin, tree.end), tree.begin, values);
+    }
+    keys = sealArray(std::move(values), arena);
+}
+
+template<typename T, typename Compare, size_t Axis>
+void RangeTree<T, 1, Compare, Axis>::fillKeys(const TreeCursor& node, uint32_t tree_begin, std::vector<T>& values) const {
+    if (node.empty()) return;
+    
+    values[tree_begin + node.index] = coord(order[node.mid]);
+    fillKeys(node.left(), tree_begin, values);
+    fillKeys(node.right(), tree_begin, values);
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Sink>
+bool RangeTree<T, 1, Compare, Axis>::rangeSearchDim(uint32_t begin, uint32_t end, const T* low, const T* high, Sink& sink,
+                                                    uint64_t free) const {
+    if (free >> Axis & 1) return reportSlice(sink, order.data() + begin, order.data() + end);
+    
+    // The boundary paths of the canonical decomposition meet the sorted range exactly
+    // at the two bounds, and everything between them is reported as one slice
+    const uint32_t first = lowerBound(keys.data(), begin, end, low[Axis], Compare());
+    const uint32_t last = upperBound(keys.data(), begin, end, high[Axis], Compare());
+    return first >= last || reportSlice(sink, order.data() + first, order.data() + last);
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Sink>
+void RangeTree<T, 1, Compare, Axis>::rangeSearchBatchDim(uint32_t begin, uint32_t end, const QueryBounds<T>* bounds,
+                                          uint32_t* queries, size_t count, Sink& sink) const {
+    for (size_t i = 0; i < count; ++i) {
+        const QueryBounds<T>& box = bounds[queries[i]];
+        const uint32_t first = lowerBound(keys.data(), begin, end, box.low[Axis], Compare());
+        const uint32_t last = upperBound(keys.data(), begin, end, box.high[Axis], Compare());
+        if (first < last) sink.slice(queries[i], order.data() + first, order.data() + last);
+    }
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<typename RangeTree<T, 1, Compare, Axis>::Point> RangeTree<T, 1, Compare, Axis>::rangeSearch(const Point& low, const Point& high) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), collect);
+    
+    std::vector<Point> result(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        result[i][0] = coord(indices[i]);
+    }
+    return result;
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<std::vector<T>> RangeTree<T, 1, Compare, Axis>::rangeSearch(const std::vector<T>& low, const std::vector<T>& high) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + 1);
+    
+    // Find results for 1D range
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), collect);
+    
+    return gatherRows(*store, indices);
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<std::vector<T>> RangeTree<T, 1, Compare, Axis>::rangeSearch(
+    std::initializer_list<T> low, std::initializer_list<T> high) const {
+    
+    return rangeSearch(std::vector<T>(low), std::vector<T>(high));
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<uint32_t> RangeTree<T, 1, Compare, Axis>::rangeSearchIndices(const Point& low, const Point& high) const {
+    std::vector<uint32_t> indices;
+    rangeSearchInto(low, high, indices);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template<typename T, typename Compare, size_t Axis>
+void RangeTree<T, 1, Compare, Axis>::rangeSearchInto(const Point& low, const Point& high, std::vector<uint32_t>& indices) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), collect);
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<uint32_t> RangeTree<T, 1, Compare, Axis>::rangeSearchIndices(const std::vector<T>& low, const std::vector<T>& high) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + 1);
+    
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), collect);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<std::vector<T>> RangeTree<T, 1, Compare, Axis>::rangeSearchColumns(const std::vector<T>& low, const std::vector<T>& high,
+                                                                const std::vector<size_t>& dims) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + 1);
+    
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), collect);
+    return gatherColumns(*store, indices, dims);
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, 1, Compare, Axis>::rangeSearch(const Point& low, const Point& high, Visitor&& visit) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    VisitPoints<T, typename std::remove_reference<Visitor>::type, 1> visitor(*store, visit);
+    return rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), visitor);
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, 1, Compare, Axis>::rangeSearch(const std::vector<T>& low, const std::vector<T>& high, Visitor&& visit) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + 1);
+    
+    VisitPoints<T, typename std::remove_reference<Visitor>::type, 1> visitor(*store, visit);
+    return rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), visitor);
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, 1, Compare, Axis>::rangeSearch(std::initializer_list<T> low, std::initializer_list<T> high, Visitor&& visit) const {
+    return rangeSearch(std::vector<T>(low), std::vector<T>(high), std::forward<Visitor>(visit));
+}
+
+template<typename T, typename Compare, size_t Axis>
+size_t RangeTree<T, 1, Compare, Axis>::rangeCount(const Point& low, const Point& high) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    CountPoints counter{0};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), low.data(), high.data(), counter);
+    return counter.count;
+}
+
+template<typename T, typename Compare, size_t Axis>
+size_t RangeTree<T, 1, Compare, Axis>::rangeCount(const std::vector<T>& low, const std::vector<T>& high) const {
+    checkQueryDimensions<T>(low.size(), high.size(), store->first_axis + 1);
+    
+    CountPoints counter{0};
+    rangeSearchDim(0, static_cast<uint32_t>(order.size()), axes(low), axes(high), counter);
+    return counter.count;
+}
+
+template<typename T, typename Compare, size_t Axis>
+size_t RangeTree<T, 1, Compare, Axis>::rangeCount(std::initializer_list<T> low, std::initializer_list<T> high) const {
+    return rangeCount(std::vector<T>(low), std::vector<T>(high));
+}
+
+template<typename T, typename Compare, size_t Axis>
+bool RangeTree<T, 1, Compare, Axis>::containsPoint(const T* point) const {
+    const uint32_t size = static_cast<uint32_t>(order.size());
+    const uint32_t first = lowerBound(keys.data(), 0, size, point[Axis], Compare());
+    return first < size && !less(point[Axis], coord(order[first]));
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Sink>
+bool RangeTree<T, 1, Compare, Axis>::searchBox(const QueryBox<T, 1>& box, Sink& sink) const {
+    const ClosedBox<T, 1> closed = closeBox<T, Compare>(box);
+    if (closed.empty) return true;
+    return rangeSearchDim(0, static_cast<uint32_t>(order.size()), closed.low.data(), closed.high.data(), sink,
+                          closed.free);
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<typename RangeTree<T, 1, Compare, Axis>::Point> RangeTree<T, 1, Compare, Axis>::rangeSearch(const QueryBox<T, 1>& box) const {
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    searchBox(box, collect);
+    
+    std::vector<Point> result(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        result[i][0] = coord(indices[i]);
+    }
+    return result;
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<uint32_t> RangeTree<T, 1, Compare, Axis>::rangeSearchIndices(const QueryBox<T, 1>& box) const {
+    std::vector<uint32_t> indices;
+    CollectIndices collect{indices};
+    searchBox(box, collect);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template<typename T, typename Compare, size_t Axis>
+size_t RangeTree<T, 1, Compare, Axis>::rangeCount(const QueryBox<T, 1>& box) const {
+    CountPoints counter{0};
+    searchBox(box, counter);
+    return counter.count;
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Visitor>
+bool RangeTree<T, 1, Compare, Axis>::rangeSearch(const QueryBox<T, 1>& box, Visitor&& visit) const {
+    VisitPoints<T, typename std::remove_reference<Visitor>::type, 1> visitor(*store, visit);
+    return searchBox(box, visitor);
+}
+
+template<typename T, typename Compare, size_t Axis>
+bool RangeTree<T, 1, Compare, Axis>::search(const Point& point) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    return containsPoint(point.data());
+}
+
+template<typename T, typename Compare, size_t Axis>
+bool RangeTree<T, 1, Compare, Axis>::search(const std::vector<T>& point) const {
+    if (point.size() < store->first_axis + 1) {
+        throw std::invalid_argument("Point dimension does not match tree dimension");
+    }
+    return containsPoint(axes(point));
+}
+
+template<typename T, typename Compare, size_t Axis>
+bool RangeTree<T, 1, Compare, Axis>::search(std::initializer_list<T> point) const {
+    return search(std::vector<T>(point));
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<bool> RangeTree<T, 1, Compare, Axis>::contains(const std::vector<Point>& points) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    // Neighbouring queries then share the top of every descent in cache
+    std::vector<uint32_t> batch = pointIndices(points.size());
+    std::sort(batch.begin(), batch.end(),
+              [&points](uint32_t a, uint32_t b) { return less(points[a][0], points[b][0]); });
+    
+    std::vector<bool> found(points.size());
+    for (uint32_t query : batch) {
+        found[query] = containsPoint(points[query].data());
+    }
+    return found;
+}
+
+template<typename T, typename Compare, size_t Axis>
+template<typename Boxes, typename Sink>
+void RangeTree<T, 1, Compare, Axis>::runBatch(const Boxes& boxes, Sink& sink) const {
+    if (store->first_axis != 0) {
+        throw std::invalid_argument("Point overloads need a tree over the leading dimensions");
+    }
+    
+    std::vector<QueryBounds<T>> bounds(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        bounds[i] = {boxes[i].low.data(), boxes[i].high.data()};
+    }
+    std::vector<uint32_t> queries = pointIndices(boxes.size());
+    rangeSearchBatchDim(0, static_cast<uint32_t>(order.size()), bounds.data(), queries.data(), queries.size(), sink);
+}
+
+template<typename T, typename Compare, size_t Axis>
+BatchResult RangeTree<T, 1, Compare, Axis>::rangeSearchBatch(const std::vector<Box>& boxes) const {
+    // One traversal appends each query's hits to its own buffer, then they are packed
+    std::vector<std::vector<uint32_t>> hits(boxes.size());
+    CollectBatch collect{hits.data()};
+    runBatch(boxes, collect);
+    return packBatch(hits);
+}
+
+template<typename T, typename Compare, size_t Axis>
+std::vector<size_t> RangeTree<T, 1, Compare, Axis>::rangeCountBatch(const std::vector<Box>& boxes) const {
+    std::vector<size_t> counts(boxes.size());
+    CountBatch counter{counts.data()};
+    runBatch(boxes, counter);
+    return counts;
+}
@@ -0,0 +1,192 @@
+// RankSpaceRangeTree.h
+#pragma once
+
+#include "RangeTree.h"
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+// Range tree over the ranks of the coordinates instead of the coordinates themselves.
+// Each dimension keeps its distinct values in order once; the tree stores and compares
+// 32-bit ranks on every level, so wide coordinates such as double or int64 shrink to 4
+// bytes per key and column entry, and bucket scans always take the int32 kernels.
+// A query maps its bounds to ranks with one binary search per side, up front.
+template<typename T, size_t K, typename Compare = std::less<T>>
+class RankSpaceRangeTree {
+public:
+    using Point = std::array<T, K>;
+    using RankPoint = std::array<int32_t, K>;
+    
+    // Coordinates must be ordered by Compare, so NaN is refused
+    RankSpaceRangeTree(const std::vector<Point>& points, const BuildOptions& opts = BuildOptions());
+    
+    // The same answers as a RangeTree<T, K, Compare> over the points, in its order
+    std::vector<Point> rangeSearch(const Point& low, const Point& high) const;
+    std::vector<uint32_t> rangeSearchIndices(const Point& low, const Point& high) const;
+    std::vector<uint32_t> rangeSearchIndices(const QueryBox<T, K>& box) const;
+    size_t rangeCount(const Point& low, const Point& high) const;
+    size_t rangeCount(const QueryBox<T, K>& box) const;
+    bool search(const Point& point) const;
+    
+    // Distinct values of a dimension in order; rank r stands for values(dim)[r]
+    const std::vector<T>& values(size_t dim) const { return ranks[dim]; }
+    
+    // The tree over the ranks
+    const RangeTree<int32_t, K>& rankTree() const { return tree; }
+    
+    // The rank tree's statistics, with the value tables counted as point bytes
+    TreeStats stats() const;
+
+private:
+    std::array<std::vector<T>, K> ranks; // Distinct values by dimension, in order
+    RangeTree<int32_t, K> tree;
+    
+    // Helper methods
+    static bool less(const T& a, const T& b) { return Compare()(a, b); }
+    static bool isNan(const T& value, std::true_type) { return std::isnan(value); }
+    static bool isNan(const T&, std::false_type) { return false; }
+    static std::array<std::vector<T>, K> rankTables(const std::vector<Point>& points);
+    std::vector<RankPoint> toRanks(const std::vector<Point>& points) const;
+    bool rankBox(const Point& low, const Point& high, RankPoint& rank_low, RankPoint& rank_high) const;
+    bool rankBox(const QueryBox<T, K>& box, RankPoint& rank_low, RankPoint& rank_high) const;
+    
+    // Ranks of the values inside a side of the box: at or after low (after, when open)
+    int32_t lowRank(size_t dim, const T& value, bool open) const {
+        const std::vector<T>& table = ranks[dim];
+        auto first = open ? std::upper_bound(table.begin(), table.end(), value, less)
+                          : std::lower_bound(table.begin(), table.end(), value, less);
+        return static_cast<int32_t>(first - table.begin());
+    }
+    int32_t highRank(size_t dim, const T& value, bool open) const {
+        const std::vector<T>& table = ranks[dim];
+        auto last = open ? std::lower_bound(table.begin(), table.end(), value, less)
+                         : std::upper_bound(table.begin(), table.end(), value, less);
+        return static_cast<int32_t>(last - table.begin()) - 1;
+    }
+};
+
+template<typename T, size_t K, typename Compare>
+RankSpaceRangeTree<T, K, Compare>::RankSpaceRangeTree(const std::vector<Point>& points, const BuildOptions& opts)
+    : ranks(rankTables(points)), tree(toRanks(points), opts) {}
+
+template<typename T, size_t K, typename Compare>
+std::array<std::vector<T>, K> RankSpaceRangeTree<T, K, Compare>::rankTables(const std::vector<Point>& points) {
+    std::array<std::vector<T>, K> tables;
+    for (size_t d = 0; d < K; ++d) {
+        std::vector<T>& table = tables[d];
+        table.reserve(points.size());
+        for (const Point& point : points) {
+            if (isNan(point[d], std::is_floating_point<T>())) {
+                throw std::invalid_argument("NaN coordinates have no rank");
+            }
+            table.push_back(point[d]);
+        }
+        std::sort(table.begin(), table.end(), less);
+        table.erase(std::unique(table.begin(), table.end(), [](const T& a, const T& b) {
+            return !less(a, b) && !less(b, a);
+        }), table.end());
+        if (table.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+            throw std::invalid_argument("Too many distinct coordinates for 32-bit ranks");
+        }
+        table.shrink_to_fit();
+    }
+    return tables;
+}
+
+template<typename T, size_t K, typename Compare>
+std::vector<typename RankSpaceRangeTree<T, K, Compare>::RankPoint>
+RankSpaceRangeTree<T, K, Compare>::toRanks(const std::vector<Point>& points) const {
+    std::vector<RankPoint> ranked(points.size());
+    for (size_t d = 0; d < K; ++d) {
+        for (size_t i = 0; i < points.size(); ++i) {
+            ranked[i][d] = lowRank(d, points[i][d], false);
+        }
+    }
+    return ranked;
+}
+
+// Rank bounds of a closed box, false when a side holds no value at all
+template<typename T, size_t K, typename Compare>
+bool RankSpaceRangeTree<T, K, Compare>::rankBox(const Point& low, const Point& high, RankPoint& rank_low,
+                                                RankPoint& rank_high) const {
+    for (size_t d = 0; d < K; ++d) {
+        rank_low[d] = lowRank(d, low[d], false);
+        rank_high[d] = highRank(d, high[d], false);
+        if (rank_high[d] < rank_low[d]) return false;
+    }
+    return true;
+}
+
+// Open and unbounded sides close exactly in rank space, for any Compare
+template<typename T, size_t K, typename Compare>
+bool RankSpaceRangeTree<T, K, Compare>::rankBox(const QueryBox<T, K>& box, RankPoint& rank_low,
+                                                RankPoint& rank_high) const {
+    for (size_t d = 0; d < K; ++d) {
+        rank_low[d] = box.low_kind[d] == Bound::Unbounded ? 0 : lowRank(d, box.low[d], box.low_kind[d] == Bound::Open);
+        rank_high[d] = box.high_kind[d] == Bound::Unbounded ? static_cast<int32_t>(ranks[d].size()) - 1
+                                                            : highRank(d, box.high[d], box.high_kind[d] == Bound::Open);
+        if (rank_high[d] < rank_low[d]) return false;
+    }
+    return true;
+}
+
+template<typename T, size_t K, typename Compare>
+std::vector<typename RankSpaceRangeTree<T, K, Compare>::Point>
+RankSpaceRangeTree<T, K, Compare>::rangeSearch(const Point& low, const Point& high) const {
+    std::vector<Point> result;
+    RankPoint rank_low, rank_high;
+    if (!rankBox(low, high, rank_low, rank_high)) return result;
+    
+    for (const RankPoint& ranked : tree.rangeSearch(rank_low, rank_high)) {
+        Point point;
+        for (size_t d = 0; d < K; ++d) point[d] = ranks[d][ranked[d]];
+        result.push_back(point);
+    }
+    return result;
+}
+
+template<typename T, size_t K, typename Compare>
+std::vector<uint32_t> RankSpaceRangeTree<T, K, Compare>::rangeSearchIndices(const Point& low, const Point& high) const {
+    RankPoint rank_low, rank_high;
+    if (!rankBox(low, high, rank_low, rank_high)) return std::vector<uint32_t>();
+    return tree.rangeSearchIndices(rank_low, rank_high);
+}
+
+template<typename T, size_t K, typename Compare>
+std::vector<uint32_t> RankSpaceRangeTree<T, K, Compare>::rangeSearchIndices(const QueryBox<T, K>& box) const {
+    RankPoint rank_low, rank_high;
+    if (!rankBox(box, rank_low, rank_high)) return std::vector<uint32_t>();
+    return tree.rangeSearchIndices(rank_low, rank_high);
+}
+
+template<typename T, size_t K, typename Compare>
+size_t RankSpaceRangeTree<T, K, Compare>::rangeCount(const Point& low, const Point& high) const {
+    RankPoint rank_low, rank_high;
+    return rankBox(low, high, rank_low, rank_high) ? tree.rangeCount(rank_low, rank_high) : 0;
+}
+
+template<typename T, size_t K, typename Compare>
+size_t RankSpaceRangeTree<T, K, Compare>::rangeCount(const QueryBox<T, K>& box) const {
+    RankPoint rank_low, rank_high;
+    return rankBox(box, rank_low, rank_high) ? tree.rangeCount(rank_low, rank_high) : 0;
+}
+
+template<typename T, size_t K, typename Compare>
+bool RankSpaceRangeTree<T, K, Compare>::search(const Point& point) const {
+    RankPoint ranked, unused;
+    return rankBox(point, point, ranked, unused) && tree.search(ranked);
+}
+
+template<typename T, size_t K, typename Compare>
+TreeStats RankSpaceRangeTree<T, K, Compare>::stats() const {
+    TreeStats stats = tree.stats();
+    for (const std::vector<T>& table : ranks) {
+        stats.point_bytes += table.size() * sizeof(T);
+    }
+    return stats;
+}
@@ -0,0 +1,165 @@
+// TopKRangeTree.h
+#pragma once
+
+#include "AggregateRangeTree.h"
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+// Range tree over points carrying a priority key each, reporting the k points of a box
+// with the highest keys without enumerating the box. Every array the canonical
+// decomposition reports slices of gets a segment tree of the position of its best point.
+// The best point of each canonical piece seeds a heap, and popping a point splits its
+// piece around it, so a query costs O((pieces + k) log n) whatever the box holds.
+template<typename T, size_t K, typename Key, typename Compare = std::less<T>>
+class TopKRangeTree {
+public:
+    using Point = std::array<T, K>;
+    
+    // keys[i] is the priority of points[i]
+    TopKRangeTree(const std::vector<Point>& points, std::vector<Key> point_keys,
+                  const BuildOptions& opts = BuildOptions());
+    
+    // Input positions of the min(k, hits) points of the box with the highest keys,
+    // highest first; equal keys come in input order
+    std::vector<uint32_t> rangeTopK(const Point& low, const Point& high, size_t k) const;
+    std::vector<uint32_t> rangeTopK(const QueryBox<T, K>& box, size_t k) const;
+    
+    // The underlying tree, for the plain queries
+    const RangeTree<T, K, Compare>& rangeTree() const { return tree; }
+
+private:
+    // Bottom-up segment tree over one array: node i holds the array position of the
+    // best point under it, leaf i is at nodes[size + i]
+    struct BestOf {
+        size_t size;
+        std::vector<uint32_t> nodes;
+    };
+    
+    // A point waiting in the heap. Points of a slice remember the rest of their piece,
+    // array[first, last), and their own position at in it; lone points have no array.
+    struct Candidate {
+        uint32_t index;
+        const uint32_t* array;
+        const BestOf* table;
+        uint32_t first, last, at;
+    };
+    
+    // Seeds the heap with every lone hit and the best point of every slice
+    struct CollectPieces {
+        const TopKRangeTree& tree;
+        std::vector<Candidate>& heap;
+        
+        bool point(uint32_t index) {
+            heap.push_back(Candidate{index, nullptr, nullptr, 0, 0, 0});
+            return true;
+        }
+        bool slice(const uint32_t* first, const uint32_t* last) {
+            const auto& entry = tree.tables.find(first);
+            tree.addPiece(entry.base, entry.table, static_cast<uint32_t>(first - entry.base),
+                          static_cast<uint32_t>(last - entry.base), heap);
+            return true;
+        }
+    };
+    
+    RangeTree<T, K, Compare> tree;
+    std::vector<Key> keys; // By input position
+    SliceTables<BestOf> tables;
+    
+    // Helper methods; keys are ordered by operator<
+    bool ranksBefore(uint32_t a, uint32_t b) const {
+        return keys[b] < keys[a] || (!(keys[a] < keys[b]) && a < b);
+    }
+    bool addPiece(const uint32_t* array, const BestOf& table, uint32_t first, uint32_t last,
+                  std::vector<Candidate>& heap) const;
+    std::vector<uint32_t> select(std::vector<Candidate>& heap, size_t k) const;
+};
+
+template<typename T, size_t K, typename Key, typename Compare>
+TopKRangeTree<T, K, Key, Compare>::TopKRangeTree(const std::vector<Point>& points, std::vector<Key> point_keys,
+                                                 const BuildOptions& opts)
+    : tree(points, opts), keys(std::move(point_keys)) {
+    if (keys.size() != points.size()) {
+        throw std::invalid_argument("Every point needs exactly one key");
+    }
+    
+    tables.build(tree, [this](const FlatArray<uint32_t>& array) {
+        BestOf built;
+        built.size = array.size();
+        built.nodes.resize(2 * built.size);
+        for (size_t i = 0; i < built.size; ++i) {
+            built.nodes[built.size + i] = static_cast<uint32_t>(i);
+        }
+        for (size_t node = built.size - 1; node > 0; --node) {
+            const uint32_t left = built.nodes[2 * node], right = built.nodes[2 * node + 1];
+            built.nodes[node] = ranksBefore(array[right], array[left]) ? right : left;
+        }
+        return built;
+    });
+}
+
+template<typename T, size_t K, typename Key, typename Compare>
+bool TopKRangeTree<T, K, Key, Compare>::addPiece(const uint32_t* array, const BestOf& table, uint32_t first,
+                                                 uint32_t last, std::vector<Candidate>& heap) const {
+    if (first >= last) return false;
+    
+    uint32_t at = table.nodes[table.size + first];
+    for (size_t lo = first + table.size, hi = last + table.size; lo < hi; lo /= 2, hi /= 2) {
+        if (lo & 1) {
+            const uint32_t node = table.nodes[lo++];
+            if (ranksBefore(array[node], array[at])) at = node;
+        }
+        if (hi & 1) {
+            const uint32_t node = table.nodes[--hi];
+            if (ranksBefore(array[node], array[at])) at = node;
+        }
+    }
+    heap.push_back(Candidate{array[at], array, &table, first, last, at});
+    return true;
+}
+
+template<typename T, size_t K, typename Key, typename Compare>
+std::vector<uint32_t> TopKRangeTree<T, K, Key, Compare>::select(std::vector<Candidate>& heap, size_t k) const {
+    auto after = [this](const Candidate& a, const Candidate& b) { return ranksBefore(b.index, a.index); };
+    std::make_heap(heap.begin(), heap.end(), after);
+    
+    std::vector<uint32_t> top;
+    while (top.size() < k && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        const Candidate best = heap.back();
+        heap.pop_back();
+        top.push_back(best.index);
+        
+        // What is left of its piece runs on either side of it
+        if (!best.array) continue;
+        if (addPiece(best.array, *best.table, best.first, best.at, heap)) {
+            std::push_heap(heap.begin(), heap.end(), after);
+        }
+        if (addPiece(best.array, *best.table, best.at + 1, best.last, heap)) {
+            std::push_heap(heap.begin(), heap.end(), after);
+        }
+    }
+    return top;
+}
+
+template<typename T, size_t K, typename Key, typename Compare>
+std::vector<uint32_t> TopKRangeTree<T, K, Key, Compare>::rangeTopK(const Point& low, const Point& high, size_t k) const {
+    if (k == 0) return std::vector<uint32_t>();
+    
+    std::vector<Candidate> heap;
+    CollectPieces collect{*this, heap};
+    SliceTables<BestOf>::decompose(tree, low, high, collect);
+    return select(heap, k);
+}
+
+template<typename T, size_t K, typename Key, typename Compare>
+std::vector<uint32_t> TopKRangeTree<T, K, Key, Compare>::rangeTopK(const QueryBox<T, K>& box, size_t k) const {
+    if (k == 0) return std::vector<uint32_t>();
+    
+    std::vector<Candidate> heap;
+    CollectPieces collect{*this, heap};
+    SliceTables<BestOf>::decompose(tree, box, collect);
+    return select(heap, k);
+}
@@ -0,0 +1,286 @@
+// TreeImage.h
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RANGE_TREE_HAVE_MMAP 1
+#endif
+
+// Array of a tree level. Built trees own their elements; opened trees view memory
+// kept alive elsewhere (the mapping of an image). Moving keeps the element pointer
+// valid since the vector's buffer moves with it; copying is not allowed.
+template<typename U>
+class FlatArray {
+public:
+    FlatArray() : elements(nullptr), count(0) {}
+    FlatArray(std::vector<U> values) : owned(std::move(values)), elements(owned.data()), count(owned.size()) {}
+    
+    FlatArray(FlatArray&& other) noexcept
+        : owned(std::move(other.owned)), elements(other.elements), count(other.count) {
+        other.elements = nullptr;
+        other.count = 0;
+    }
+    
+    FlatArray& operator=(FlatArray&& other) noexcept {
+        owned = std::move(other.owned);
+        elements = other.elements;
+        count = other.count;
+        other.elements = nullptr;
+        other.count = 0;
+        return *this;
+    }
+    
+    FlatArray(const FlatArray&) = delete;
+    FlatArray& operator=(const FlatArray&) = delete;
+    
+    static FlatArray view(const U* data, size_t size) {
+        FlatArray array;
+        array.elements = data;
+        array.count = size;
+        return array;
+    }
+    
+    const U& operator[](size_t i) const { return elements[i]; }
+    const U* data() const { return elements; }
+    const U* begin() const { return elements; }
+    const U* end() const { return elements + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    std::vector<U> owned;
+    const U* elements;
+    size_t count;
+};
+
+// Monotonic arena: hands out aligned blocks from chunks that only grow, and
+// releases everything at once when destroyed. Allocation is thread-safe.
+class Arena {
+public:
+    explicit Arena(size_t first_chunk = 1 << 20) : next_chunk(std::max<size_t>(first_chunk, 64)), top(0), used(0) {}
+    
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+    
+    template<typename U>
+    U* allocateArray(size_t count) { return static_cast<U*>(allocate(count * sizeof(U), alignof(U))); }
+    
+    size_t bytesUsed() const;
+    size_t bytesReserved() const;
+    size_t chunkCount() const;
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> bytes;
+        size_t size;
+    };
+    
+    mutable std::mutex mutex;
+    std::vector<Chunk> chunks;
+    size_t next_chunk; // Size of the next chunk; doubles each time
+    size_t top; // First free byte of the last chunk
+    size_t used;
+};
+
+inline void* Arena::allocate(size_t bytes, size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto aligned = [alignment](const Chunk& chunk, size_t offset) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.bytes.get());
+        return static_cast<size_t>(((base + offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base);
+    };
+    
+    size_t offset = chunks.empty() ? 0 : aligned(chunks.back(), top);
+    if (chunks.empty() || offset + bytes > chunks.back().size) {
+        const size_t size = std::max(next_chunk, bytes + alignment);
+        chunks.push_back({std::unique_ptr<char[]>(new char[size]), size});
+        next_chunk = 2 * size;
+        offset = aligned(chunks.back(), 0);
+    }
+    
+    top = offset + bytes;
+    used += bytes;
+    return chunks.back().bytes.get() + offset;
+}
+
+inline size_t Arena::bytesUsed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used;
+}
+
+inline size_t Arena::bytesReserved() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) total += chunk.size;
+    return total;
+}
+
+inline size_t Arena::chunkCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return chunks.size();
+}
+
+// Moves finished build output into its final storage: a copy in the arena when
+// there is one, otherwise the vector itself. Types that need their destructors
+// run always keep the vector, since the arena never runs any.
+template<typename U>
+FlatArray<U> sealArray(std::vector<U> values, Arena* arena) {
+    if (!arena || !std::is_trivially_copyable<U>::value || values.empty()) {
+        return FlatArray<U>(std::move(values));
+    }
+    U* copy = arena->allocateArray<U>(values.size());
+    std::uninitialized_copy(values.begin(), values.end(), copy);
+    return FlatArray<U>::view(copy, values.size());
+}
+
+// Read-only view of a whole file, mapped where the platform allows it
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes;
+    size_t length;
+    std::vector<char> contents; // Fallback copy without mmap
+};
+
+inline MappedFile::MappedFile(const std::string& path) : bytes(nullptr), length(0) {
+#if defined(RANGE_TREE_HAVE_MMAP)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open range tree image: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot read range tree image: " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map range tree image: " + path);
+        }
+        bytes = static_cast<const char*>(mapping);
+    }
+    ::close(fd); // The mapping stays valid on its own
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open range tree image: " + path);
+    }
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    bytes = contents.data();
+    length = contents.size();
+#endif
+}
+
+inline MappedFile::~MappedFile() {
+#if defined(RANGE_TREE_HAVE_MMAP)
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+}
+
+// Image layout: a fixed header of 64-bit words, then every array as its 64-bit
+// length followed by its elements, starting on a 64-byte boundary
+const size_t image_alignment = 64;
+const char image_magic[8] = {'R', 'N', 'G', 'T', 'R', 'E', 'E', '1'};
+
+class ImageWriter {
+public:
+    explicit ImageWriter(const std::string& path) : out(path, std::ios::binary | std::ios::trunc), offset(0) {
+        if (!out) {
+            throw std::runtime_error("Cannot create range tree image: " + path);
+        }
+    }
+    
+    void writeValue(uint64_t value) { writeBytes(&value, sizeof(value)); }
+    
+    template<typename U>
+    void writeArray(const U* data, size_t count) {
+        beginArray(count);
+        writeBytes(data, count * sizeof(U));
+    }
+    
+    // Length and padding of an array whose elements the caller then streams through writeBytes
+    void beginArray(size_t count) {
+        writeValue(count);
+        static const char zeros[image_alignment] = {};
+        writeBytes(zeros, (image_alignment - offset % image_alignment) % image_alignment);
+    }
+    
+    void writeBytes(const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        if (!out) {
+            throw std::runtime_error("Cannot write range tree image");
+        }
+        offset += size;
+    }
+
+private:
+    std::ofstream out;
+    size_t offset;
+};
+
+class ImageReader {
+public:
+    explicit ImageReader(const std::string& path) : file(std::make_shared<MappedFile>(path)), offset(0) {}
+    
+    // Keeps the mapping alive for as long as anything views it
+    std::shared_ptr<const MappedFile> backing() const { return file; }
+    
+    uint64_t readValue() {
+        uint64_t value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+    
+    // View of the next array, straight in the mapped pages
+    template<typename U>
+    FlatArray<U> readArray() {
+        const uint64_t count = readValue();
+        take((image_alignment - offset % image_alignment) % image_alignment);
+        if (count > (file->size() - offset) / sizeof(U)) {
+            throw std::runtime_error("Range tree image is truncated");
+        }
+        return FlatArray<U>::view(reinterpret_cast<const U*>(take(count * sizeof(U))), count);
+    }
+    
+    const char* take(size_t size) {
+        if (size > file->size() - offset) {
+            throw std::runtime_error("Range tree image is truncated");
+        }
+        const char* bytes = file->data() + offset;
+        offset += size;
+        return bytes;
+    }
+
+private:
+    std::shared_ptr<const MappedFile> file;
+    size_t offset;
+};
@@ -1,10 +1,9 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <chrono>
 #include "RangeTree.h"
 
-// Function to test the range tree with timings
+// Walks through building and querying small trees; timings live in bench/suite.cpp
 void testRangeTree(std::ofstream& output_file) {
     output_file << "Range Tree Test Results" << std::endl;
     output_file << "=======================" << std::endl << std::endl;
@@ -18,13 +17,8 @@ void testRangeTree(std::ofstream& output_file) {
     
     output_file << "Building 2D Range Tree with " << points_2d.size() << " points..." << std::endl;
     
-    // Time the construction of the 2D range tree
-    auto start = std::chrono::high_resolution_clock::now();
     RangeTree<int, 2> tree_2d(points_2d);
-    auto end = std::chrono::high_resolution_clock::now();
-    
-    std::chrono::duration<double, std::milli> elapsed = end - start;
-    output_file << "Construction time: " << elapsed.count() << " ms" << std::endl << std::endl;
+    output_file << std::endl;
     
     // Test 2D range queries
     output_file << "2D Range Queries:" << std::endl;
@@ -47,13 +41,8 @@ void testRangeTree(std::ofstream& output_file) {
         output_file << "Query range: [(" << low[0] << "," << low[1] << "), (" 
                   << high[0] << "," << high[1] << ")]" << std::endl;
         
-        start = std::chrono::high_resolution_clock::now();
         auto results = tree_2d.rangeSearch(low, high);
-        end = std::chrono::high_resolution_clock::now();
-        
-        elapsed = end - start;
-        
-        output_file << "Found " << results.size() << " points in " << elapsed.count() << " ms:" << std::endl;
+        output_file << "Found " << results.size() << " points:" << std::endl;
         for (const auto& point : results) {
             output_file << "  (" << point[0] << "," << point[1] << ")" << std::endl;
         }
@@ -73,14 +62,7 @@ void testRangeTree(std::ofstream& output_file) {
     
     for (const auto& point : test_points) {
         output_file << "Searching for point (" << point[0] << "," << point[1] << "): ";
-        
-        start = std::chrono::high_resolution_clock::now();
-        bool found = tree_2d.search(point);
-        end = std::chrono::high_resolution_clock::now();
-        
-        elapsed = end - start;
-        
-        output_file << (found ? "Found" : "Not Found") << " in " << elapsed.count() << " ms" << std::endl;
+        output_file << (tree_2d.search(point) ? "Found" : "Not Found") << std::endl;
     }
     output_file << std::endl;
     
@@ -94,13 +76,8 @@ void testRangeTree(std::ofstream& output_file) {
     };
     
     output_file << "Building 3D Range Tree with " << points_3d.size() << " points..." << std::endl;
-    
-    start = std::chrono::high_resolution_clock::now();
     RangeTree<int, 3> tree_3d(points_3d);
-    end = std::chrono::high_resolution_clock::now();
-    
-    elapsed = end - start;
-    output_file << "Construction time: " << elapsed.count() << " ms" << std::endl << std::endl;
+    output_file << std::endl;
     
     // Test 3D range query
     std::vector<int> low_3d = {5, 5, 3};
@@ -109,13 +86,8 @@ void testRangeTree(std::ofstream& output_file) {
     output_file << "3D Query range: [(" << low_3d[0] << "," << low_3d[1] << "," << low_3d[2] << "), (" 
               << high_3d[0] << "," << high_3d[1] << "," << high_3d[2] << ")]" << std::endl;
     
-    start = std::chrono::high_resolution_clock::now();
     auto results_3d = tree_3d.rangeSearch(low_3d, high_3d);
-    end = std::chrono::high_resolution_clock::now();
-    
-    elapsed = end - start;
-    
-    output_file << "Found " << results_3d.size() << " points in " << elapsed.count() << " ms:" << std::endl;
+    output_file << "Found " << results_3d.size() << " points:" << std::endl;
     for (const auto& point : results_3d) {
         output_file << "  (" << point[0] << "," << point[1] << "," << point[2] << ")" << std::endl;
     }
@@ -6,7 +6,20 @@
 #include <cmath>
 #include <set>
 #include <algorithm>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <cstdlib>
+#include <new>
 #include "../src/RangeTree.h"
+#include "../src/QueryExecutor.h"
+#include "../src/DynamicRangeTree.h"
+#include "../src/AggregateRangeTree.h"
+#include "../src/TopKRangeTree.h"
+#include "../src/ExternalBuilder.h"
+#include "../src/RankSpaceRangeTree.h"
+#include "../src/IndexHandle.h"
+#include "../src/MultisetRangeTree.h"
 
 // Simple test framework
 #define TEST(name) void name()
@@ -122,6 +135,49 @@ bool isPointInRange(const std::vector<T> &point, const std::vector<T> &low, cons
     return true;
 }
 
+// Deterministic pseudo-random numbers so failures are reproducible
+unsigned nextRandom(unsigned &seed)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 16;
+}
+
+std::vector<std::vector<int>> randomPoints(size_t count, size_t dims, int domain, unsigned &seed)
+{
+    std::vector<std::vector<int>> points;
+    for (size_t i = 0; i < count; i++)
+    {
+        std::vector<int> point;
+        for (size_t d = 0; d < dims; d++)
+        {
+            point.push_back(nextRandom(seed) % domain);
+        }
+        points.push_back(point);
+    }
+    return points;
+}
+
+// Counts every heap allocation of the process, so tests can check a query makes none
+std::atomic<size_t> heap_allocations(0);
+
+void *operator new(size_t size)
+{
+    heap_allocations++;
+    if (void *block = std::malloc(size ? size : 1))
+        return block;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    operator delete(block);
+}
+
 // Tests for an empty Range Tree
 TEST(test_empty_tree)
 {
@@ -131,6 +187,7 @@ TEST(test_empty_tree)
     // Test range search on empty tree
     auto results = tree.rangeSearch({0, 0}, {10, 10});
     ASSERT_EQUAL(results.size(), 0);
+    ASSERT_EQUAL(tree.rangeCount({0, 0}, {10, 10}), 0);
 
     // Test point search on empty tree
     ASSERT_FALSE(tree.search({3, 6}));
@@ -395,12 +452,11 @@ TEST(test_large_dataset)
     }
 
     // Test range query for a subset of points
-    auto results = tree.rangeSearch({3, 3}, {6, 6});
-    ASSERT_EQUAL(results.size(), 16); // 4x4 grid from (3,3) to (6,6)
+    ASSERT_EQUAL(tree.rangeCount({3, 3}, {6, 6}), 16); // 4x4 grid from (3,3) to (6,6)
 
     // Test range query for all points
-    results = tree.rangeSearch({0, 0}, {9, 9});
-    ASSERT_EQUAL(results.size(), 100); // 10x10 grid
+    ASSERT_EQUAL(tree.rangeCount({0, 0}, {9, 9}), 100); // 10x10 grid
+    ASSERT_EQUAL(tree.rangeCount({-5, 4}, {2, 4}), 3);
 }
 
 // Test for invalid input data
@@ -439,6 +495,1639 @@ TEST(test_inverted_ranges)
     ASSERT_EQUAL(results.size(), 0);
 }
 
+// Checks a tree against a brute-force scan over random boxes
+template <typename Tree>
+bool matchesBruteForce(const Tree &tree, const std::vector<std::vector<int>> &points, size_t dims, unsigned &seed)
+{
+    for (int q = 0; q < 50; q++)
+    {
+        std::vector<int> low, high;
+        for (size_t d = 0; d < dims; d++)
+        {
+            int a = nextRandom(seed) % 22 - 1;
+            int b = nextRandom(seed) % 22 - 1;
+            low.push_back(std::min(a, b));
+            high.push_back(std::max(a, b));
+        }
+
+        size_t expected = 0;
+        for (const auto &point : points)
+        {
+            if (isPointInRange(point, low, high))
+                expected++;
+        }
+
+        auto results = tree.rangeSearch(low, high);
+        if (results.size() != expected || tree.rangeCount(low, high) != expected)
+            return false;
+        for (const auto &point : results)
+        {
+            if (!isPointInRange(point, low, high))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Tests canonical decomposition against a brute-force scan, including duplicate coordinates
+TEST(test_query_matches_brute_force)
+{
+    unsigned seed = 12345;
+    auto points_2d = randomPoints(300, 2, 20, seed); // Small domain forces many ties
+    auto points_3d = randomPoints(300, 3, 20, seed);
+    auto points_4d = randomPoints(300, 4, 20, seed);
+
+    RangeTree<int, 2> tree_2d(points_2d);
+    RangeTree<int, 3> tree_3d(points_3d);
+    RangeTree<int, 4> tree_4d(points_4d);
+
+    ASSERT_TRUE(matchesBruteForce(tree_2d, points_2d, 2, seed));
+    ASSERT_TRUE(matchesBruteForce(tree_3d, points_3d, 3, seed));
+    ASSERT_TRUE(matchesBruteForce(tree_4d, points_4d, 4, seed));
+}
+
+// Tests the fractional cascading layout of the last two dimensions
+TEST(test_fractional_cascading)
+{
+    unsigned seed = 777;
+    auto points_2d = randomPoints(300, 2, 20, seed);
+    auto points_3d = randomPoints(300, 3, 20, seed);
+
+    BuildOptions options;
+    options.fractional_cascading = true;
+    RangeTree<int, 2> tree_2d(points_2d, options);
+    RangeTree<int, 3> tree_3d(points_3d, options);
+
+    ASSERT_TRUE(matchesBruteForce(tree_2d, points_2d, 2, seed));
+    ASSERT_TRUE(matchesBruteForce(tree_3d, points_3d, 3, seed));
+
+    ASSERT_TRUE(tree_2d.search(points_2d[17]));
+    ASSERT_FALSE(tree_2d.search({25, 25}));
+    ASSERT_EQUAL(tree_2d.rangeSearch({0, 0}, {19, 19}).size(), points_2d.size());
+
+    // Empty trees and inverted ranges
+    std::vector<std::vector<int>> empty_points;
+    RangeTree<int, 2> empty_tree(empty_points, options);
+    ASSERT_EQUAL(empty_tree.rangeSearch({0, 0}, {10, 10}).size(), 0);
+    ASSERT_EQUAL(tree_2d.rangeSearch({0, 15}, {19, 5}).size(), 0);
+}
+
+// Tests the fixed-size std::array point API against the vector one
+TEST(test_array_point_api)
+{
+    unsigned seed = 4242;
+    auto points_3d = randomPoints(200, 3, 20, seed);
+
+    std::vector<std::array<int, 3>> array_points;
+    for (const auto &point : points_3d)
+    {
+        array_points.push_back({{point[0], point[1], point[2]}});
+    }
+
+    RangeTree<int, 3> vector_tree(points_3d);
+    RangeTree<int, 3> array_tree(array_points);
+
+    std::array<int, 3> low = {{2, 4, 6}};
+    std::array<int, 3> high = {{12, 15, 18}};
+    auto array_results = array_tree.rangeSearch(low, high);
+    auto vector_results = vector_tree.rangeSearch({2, 4, 6}, {12, 15, 18});
+
+    ASSERT_EQUAL(array_results.size(), vector_results.size());
+    std::set<std::array<int, 3>> expected;
+    for (const auto &point : vector_results)
+    {
+        expected.insert({{point[0], point[1], point[2]}});
+    }
+    for (const auto &point : array_results)
+    {
+        ASSERT_TRUE(expected.count(point) == 1);
+    }
+
+    ASSERT_TRUE(array_tree.search(array_points[5]));
+    ASSERT_FALSE(array_tree.search(std::array<int, 3>{{30, 30, 30}}));
+
+    // The 1D specialization takes the same point type
+    std::vector<std::array<float, 1>> points_1d = {{{1.5f}}, {{-2.0f}}, {{7.25f}}};
+    RangeTree<float, 1> tree_1d(points_1d);
+    ASSERT_EQUAL(tree_1d.rangeSearch(std::array<float, 1>{{-3.0f}}, std::array<float, 1>{{2.0f}}).size(), 2);
+    ASSERT_TRUE(tree_1d.search(std::array<float, 1>{{7.25f}}));
+}
+
+// Every tree shape of the implicit layout, from a single node up to a few full levels
+TEST(test_implicit_layout_sizes)
+{
+    unsigned seed = 99;
+    for (size_t n = 1; n <= 40; n++)
+    {
+        auto points_1d = randomPoints(n, 1, 8, seed);
+        auto points_2d = randomPoints(n, 2, 8, seed);
+        RangeTree<int, 1> tree_1d(points_1d);
+        RangeTree<int, 2> tree_2d(points_2d);
+
+        BuildOptions options;
+        options.fractional_cascading = true;
+        RangeTree<int, 2> cascading_2d(points_2d, options);
+
+        ASSERT_EQUAL(tree_1d.rangeSearch({0}, {7}).size(), n);
+        ASSERT_TRUE(matchesBruteForce(tree_1d, points_1d, 1, seed));
+        ASSERT_TRUE(matchesBruteForce(tree_2d, points_2d, 2, seed));
+        ASSERT_TRUE(matchesBruteForce(cascading_2d, points_2d, 2, seed));
+    }
+}
+
+// A parallel build must produce exactly the serial tree, down to the order of results
+TEST(test_parallel_build)
+{
+    unsigned seed = 4242;
+    auto points = randomPoints(2000, 3, 50, seed);
+
+    BuildOptions parallel;
+    parallel.threads = 4;
+    parallel.parallel_cutoff = 1; // Every associated level becomes a task
+    RangeTree<int, 3> serial_tree(points);
+    RangeTree<int, 3> parallel_tree(points, parallel);
+
+    parallel.fractional_cascading = true;
+    RangeTree<int, 3> cascading_tree(points, parallel);
+    ASSERT_TRUE(matchesBruteForce(cascading_tree, points, 3, seed));
+
+    bool identical = true;
+    for (int q = 0; q < 50; q++)
+    {
+        std::vector<int> low, high;
+        for (int d = 0; d < 3; d++)
+        {
+            int a = nextRandom(seed) % 50;
+            int b = nextRandom(seed) % 50;
+            low.push_back(std::min(a, b));
+            high.push_back(std::max(a, b));
+        }
+        if (serial_tree.rangeSearch(low, high) != parallel_tree.rangeSearch(low, high))
+            identical = false;
+    }
+    ASSERT_TRUE(identical);
+}
+
+// Visitor queries see every hit with its input index, and stop when told to
+TEST(test_visitor_range_search)
+{
+    unsigned seed = 31337;
+    auto points = randomPoints(500, 2, 30, seed);
+    RangeTree<int, 2> tree(points);
+
+    BuildOptions options;
+    options.fractional_cascading = true;
+    RangeTree<int, 2> cascading_tree(points, options);
+
+    size_t visited = 0;
+    bool indices_match = true;
+    auto visit = [&](uint32_t index, const int *coords)
+    {
+        visited++;
+        if (points[index][0] != coords[0] || points[index][1] != coords[1])
+            indices_match = false;
+        return true;
+    };
+    ASSERT_TRUE(tree.rangeSearch({5, 5}, {20, 25}, visit));
+    ASSERT_EQUAL(visited, tree.rangeCount({5, 5}, {20, 25}));
+    ASSERT_TRUE(indices_match);
+
+    // First match only
+    size_t calls = 0;
+    auto first_only = [&calls](uint32_t, const int *)
+    {
+        calls++;
+        return false;
+    };
+    ASSERT_FALSE(tree.rangeSearch({0, 0}, {29, 29}, first_only));
+    ASSERT_EQUAL(calls, 1);
+    calls = 0;
+    ASSERT_FALSE(cascading_tree.rangeSearch({0, 0}, {29, 29}, first_only));
+    ASSERT_EQUAL(calls, 1);
+
+    // No hits: the visitor is never called and the query completes
+    calls = 0;
+    ASSERT_TRUE(tree.rangeSearch({40, 40}, {50, 50}, first_only));
+    ASSERT_EQUAL(calls, 0);
+
+    RangeTree<int, 1> tree_1d(randomPoints(100, 1, 10, seed));
+    calls = 0;
+    ASSERT_FALSE(tree_1d.rangeSearch({2}, {7}, first_only));
+    ASSERT_EQUAL(calls, 1);
+
+    // No overload allocates, on the bucket and cascading paths alike
+    RangeTree<int, 2>::Point low = {{5, 5}}, high = {{20, 25}};
+    std::vector<int> low_vector = {5, 5}, high_vector = {20, 25}, low_1d = {2}, high_1d = {7};
+    QueryBox<int, 2> box = QueryBox<int, 2>().between(0, 5, 20).lower(1, 5, Bound::Open);
+    visited = 0;
+    size_t allocations = heap_allocations.load();
+    tree.rangeSearch(low, high, visit);
+    tree.rangeSearch(low_vector, high_vector, visit);
+    tree.rangeSearch(box, visit);
+    cascading_tree.rangeSearch(low, high, visit);
+    tree_1d.rangeSearch(low_1d, high_1d, first_only);
+    allocations = heap_allocations.load() - allocations;
+    ASSERT_EQUAL(allocations, 0);
+    ASSERT_TRUE(visited > 0 && indices_match);
+}
+
+// Exact-match search and batched contains against a brute-force membership check
+TEST(test_exact_match_search)
+{
+    unsigned seed = 2718;
+    std::vector<std::vector<int>> points;
+    for (int i = 0; i < 400; i++)
+    {
+        // Few distinct x values: long runs of equal keys take the fallback path
+        points.push_back({static_cast<int>(nextRandom(seed) % 3), static_cast<int>(nextRandom(seed) % 40),
+                          static_cast<int>(nextRandom(seed) % 40)});
+    }
+
+    BuildOptions options;
+    options.fractional_cascading = true;
+    RangeTree<int, 3> tree(points);
+    RangeTree<int, 3> cascading_tree(points, options);
+
+    std::vector<RangeTree<int, 3>::Point> queries;
+    std::vector<bool> expected;
+    for (int q = 0; q < 200; q++)
+    {
+        std::vector<int> query = {static_cast<int>(nextRandom(seed) % 4), static_cast<int>(nextRandom(seed) % 40),
+                                  static_cast<int>(nextRandom(seed) % 40)};
+        queries.push_back({{query[0], query[1], query[2]}});
+        expected.push_back(std::find(points.begin(), points.end(), query) != points.end());
+    }
+
+    bool all_match = true;
+    for (size_t q = 0; q < queries.size(); q++)
+    {
+        if (tree.search(queries[q]) != expected[q] || cascading_tree.search(queries[q]) != expected[q])
+            all_match = false;
+    }
+    ASSERT_TRUE(all_match);
+    ASSERT_TRUE(tree.contains(queries) == expected);
+    ASSERT_TRUE(cascading_tree.contains(queries) == expected);
+
+    std::vector<std::vector<int>> points_1d = {{4}, {1}, {4}, {9}};
+    RangeTree<int, 1> tree_1d(points_1d);
+    ASSERT_TRUE(tree_1d.contains({{{4}}, {{5}}, {{9}}, {{0}}}) == std::vector<bool>({true, false, true, false}));
+}
+
+// Indices of the hits of one single-query search, sorted
+template <typename Tree, typename Point>
+std::vector<uint32_t> hitIndices(const Tree &tree, const Point &low, const Point &high)
+{
+    std::vector<uint32_t> indices;
+    tree.rangeSearch(low, high, [&indices](uint32_t index, const int *)
+                     {
+                         indices.push_back(index);
+                         return true;
+                     });
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+// A batch must return exactly what its queries return one at a time
+template <typename Tree>
+bool batchMatchesSingle(const Tree &tree, const std::vector<typename Tree::Box> &boxes)
+{
+    BatchResult batch = tree.rangeSearchBatch(boxes);
+    std::vector<size_t> counts = tree.rangeCountBatch(boxes);
+    if (batch.offsets.size() != boxes.size() + 1 || counts.size() != boxes.size())
+        return false;
+
+    for (size_t q = 0; q < boxes.size(); q++)
+    {
+        std::vector<uint32_t> hits(batch.indices.begin() + batch.offsets[q], batch.indices.begin() + batch.offsets[q + 1]);
+        std::sort(hits.begin(), hits.end());
+        if (hits != hitIndices(tree, boxes[q].low, boxes[q].high) || counts[q] != hits.size())
+            return false;
+    }
+    return true;
+}
+
+// Batched searches and counts, cascading and 1D included, against the same queries run one at a time
+TEST(test_batch_queries)
+{
+    unsigned seed = 1618;
+    auto points = randomPoints(600, 3, 20, seed);
+    RangeTree<int, 3> tree(points);
+
+    BuildOptions options;
+    options.fractional_cascading = true;
+    RangeTree<int, 3> cascading_tree(points, options);
+
+    std::vector<RangeTree<int, 3>::Box> boxes;
+    for (int q = 0; q < 200; q++)
+    {
+        RangeTree<int, 3>::Box box;
+        for (int d = 0; d < 3; d++)
+        {
+            // Some boxes come out inverted on purpose
+            box.low[d] = nextRandom(seed) % 22 - 1;
+            box.high[d] = box.low[d] + static_cast<int>(nextRandom(seed) % 12) - 2;
+        }
+        boxes.push_back(box);
+    }
+    ASSERT_TRUE(batchMatchesSingle(tree, boxes));
+    ASSERT_TRUE(batchMatchesSingle(cascading_tree, boxes));
+
+    RangeTree<int, 1> tree_1d(randomPoints(100, 1, 20, seed));
+    std::vector<RangeTree<int, 1>::Box> boxes_1d = {{{{2}}, {{9}}}, {{{15}}, {{3}}}, {{{0}}, {{19}}}};
+    ASSERT_TRUE(batchMatchesSingle(tree_1d, boxes_1d));
+
+    // Empty batches and empty trees
+    ASSERT_EQUAL(tree.rangeSearchBatch({}).offsets.size(), 1);
+    std::vector<RangeTree<int, 3>::Point> no_points;
+    RangeTree<int, 3> empty_tree(no_points);
+    ASSERT_EQUAL(empty_tree.rangeCountBatch(boxes)[0], 0);
+}
+
+// Many threads over one shared tree must see exactly the serial results (run under make test-tsan too)
+TEST(test_concurrent_query_stress)
+{
+    unsigned seed = 5150;
+    auto points = randomPoints(3000, 3, 40, seed);
+    RangeTree<int, 3> tree(points);
+
+    BuildOptions options;
+    options.fractional_cascading = true;
+    RangeTree<int, 3> cascading_tree(points, options);
+
+    QueryExecutor executor(4, 8);
+    bool executor_matches = true;
+    for (int round = 0; round < 10; round++)
+    {
+        std::vector<RangeTree<int, 3>::Box> boxes;
+        for (int q = 0; q < 300; q++)
+        {
+            RangeTree<int, 3>::Box box;
+            for (int d = 0; d < 3; d++)
+            {
+                box.low[d] = nextRandom(seed) % 40;
+                box.high[d] = box.low[d] + static_cast<int>(nextRandom(seed) % 15);
+            }
+            boxes.push_back(box);
+        }
+
+        const RangeTree<int, 3> &shared = round % 2 ? cascading_tree : tree;
+        BatchResult parallel = executor.rangeSearch(shared, boxes);
+        std::vector<size_t> counts = executor.rangeCount(shared, boxes);
+        for (size_t q = 0; q < boxes.size(); q++)
+        {
+            std::vector<uint32_t> hits(parallel.indices.begin() + parallel.offsets[q],
+                                       parallel.indices.begin() + parallel.offsets[q + 1]);
+            std::sort(hits.begin(), hits.end());
+            if (hits != hitIndices(shared, boxes[q].low, boxes[q].high) || counts[q] != hits.size())
+                executor_matches = false;
+        }
+    }
+    ASSERT_TRUE(executor_matches);
+
+    // Plain threads hammering the same tree with every query kind
+    std::vector<RangeTree<int, 3>::Point> lows, highs;
+    std::vector<size_t> expected;
+    for (int q = 0; q < 200; q++)
+    {
+        int x = nextRandom(seed) % 40, y = nextRandom(seed) % 40, z = nextRandom(seed) % 40;
+        lows.push_back({{x, y, z}});
+        highs.push_back({{x + 10, y + 10, z + 10}});
+        expected.push_back(tree.rangeSearch(lows.back(), highs.back()).size());
+    }
+    std::atomic<int> mismatches(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t]()
+                             {
+                                 for (size_t q = t; q < lows.size(); q += 2)
+                                 {
+                                     if (tree.rangeCount(lows[q], highs[q]) != expected[q] ||
+                                         tree.rangeSearch(lows[q], highs[q]).size() != expected[q] ||
+                                         !tree.search(points[q]))
+                                         mismatches++;
+                                 }
+                             });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    ASSERT_EQUAL(mismatches.load(), 0);
+
+    // A failing chunk surfaces in the caller once the loop has drained
+    WorkStealingPool pool(3);
+    bool thrown = false;
+    try
+    {
+        pool.parallelFor(100, 4, [](unsigned, size_t first, size_t)
+                         {
+                             if (first == 40)
+                                 throw std::runtime_error("chunk failed");
+                         });
+    }
+    catch (const std::runtime_error &)
+    {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+// Random inserts and erases against a brute-force multiset, across many level merges
+TEST(test_dynamic_insert_erase)
+{
+    unsigned seed = 8080;
+    DynamicRangeTree<int, 2> tree(BuildOptions(), 8);
+    std::multiset<std::array<int, 2>> reference;
+
+    bool counts_match = true, results_match = true, erase_match = true;
+    for (int step = 0; step < 3000; step++)
+    {
+        std::array<int, 2> point = {{static_cast<int>(nextRandom(seed) % 30), static_cast<int>(nextRandom(seed) % 30)}};
+        if (nextRandom(seed) % 3 == 0)
+        {
+            auto found = reference.find(point);
+            bool expected = found != reference.end();
+            if (expected)
+                reference.erase(found);
+            if (tree.erase(point) != expected)
+                erase_match = false;
+        }
+        else
+        {
+            tree.insert(point);
+            reference.insert(point);
+        }
+
+        if (step % 50 == 0)
+        {
+            std::array<int, 2> low = {{static_cast<int>(nextRandom(seed) % 30), static_cast<int>(nextRandom(seed) % 30)}};
+            std::array<int, 2> high = {{low[0] + 8, low[1] + 8}};
+            std::multiset<std::array<int, 2>> expected;
+            for (const auto &p : reference)
+            {
+                if (p[0] >= low[0] && p[0] <= high[0] && p[1] >= low[1] && p[1] <= high[1])
+                    expected.insert(p);
+            }
+            auto results = tree.rangeSearch(low, high);
+            if (std::multiset<std::array<int, 2>>(results.begin(), results.end()) != expected)
+                results_match = false;
+            if (tree.rangeCount(low, high) != expected.size() || tree.size() != reference.size())
+                counts_match = false;
+        }
+    }
+    ASSERT_TRUE(erase_match);
+    ASSERT_TRUE(results_match);
+    ASSERT_TRUE(counts_match);
+
+    // Drain everything through erase
+    std::vector<std::array<int, 2>> remaining(reference.begin(), reference.end());
+    for (const auto &point : remaining)
+        tree.erase(point);
+    ASSERT_TRUE(tree.empty());
+    ASSERT_FALSE(tree.search({{1, 1}}));
+}
+
+// Trees reopened from an image answer exactly like the trees that wrote them
+TEST(test_save_and_open_image)
+{
+    unsigned seed = 6502;
+    auto points = randomPoints(800, 3, 25, seed);
+    const char *path = "range_tree_test_image.bin";
+
+    BuildOptions options;
+    options.fractional_cascading = true;
+    RangeTree<int, 3> tree(points);
+    RangeTree<int, 3> cascading_tree(points, options);
+
+    bool all_match = true;
+    for (const RangeTree<int, 3> *original : {&tree, &cascading_tree})
+    {
+        original->save(path);
+        RangeTree<int, 3> opened = RangeTree<int, 3>::open(path);
+        for (int q = 0; q < 50; q++)
+        {
+            RangeTree<int, 3>::Point low, high;
+            for (int d = 0; d < 3; d++)
+            {
+                low[d] = nextRandom(seed) % 25;
+                high[d] = low[d] + static_cast<int>(nextRandom(seed) % 10);
+            }
+            if (hitIndices(opened, low, high) != hitIndices(*original, low, high) ||
+                opened.rangeSearch(low, high) != original->rangeSearch(low, high))
+                all_match = false;
+        }
+        if (!opened.search(points[7]))
+            all_match = false;
+    }
+    ASSERT_TRUE(all_match);
+    ASSERT_TRUE(matchesBruteForce(RangeTree<int, 3>::open(path), points, 3, seed));
+
+    // The vector API over trailing dimensions and the 1D base case round-trip too
+    RangeTree<int, 2> trailing(points, 1);
+    trailing.save(path);
+    std::vector<int> low = {0, 3, 3}, high = {0, 12, 12};
+    auto reopened_trailing = RangeTree<int, 2>::open(path);
+    ASSERT_EQUAL(reopened_trailing.rangeCount(low, high), trailing.rangeCount(low, high));
+    RangeTree<int, 1> tree_1d(randomPoints(100, 1, 25, seed));
+    tree_1d.save(path);
+    RangeTree<int, 1>::Point low_1d = {{5}}, high_1d = {{15}};
+    auto reopened_1d = RangeTree<int, 1>::open(path);
+    ASSERT_EQUAL(reopened_1d.rangeCount(low_1d, high_1d), tree_1d.rangeCount(low_1d, high_1d));
+
+    // Images only open as the tree type that wrote them
+    bool rejected = false;
+    try
+    {
+        RangeTree<int, 3>::open(path);
+    }
+    catch (const std::runtime_error &)
+    {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+    std::remove(path);
+}
+
+// Arena-backed trees carve every array from the arena, keep it alive and answer as usual
+TEST(test_arena_backed_build)
+{
+    unsigned seed = 1985;
+    auto points = randomPoints(600, 3, 30, seed);
+
+    BuildOptions options;
+    options.arena = std::make_shared<Arena>(size_t(8) << 20);
+    std::weak_ptr<Arena> arena = options.arena;
+    std::unique_ptr<RangeTree<int, 3>> tree(new RangeTree<int, 3>(points, options));
+    options.arena.reset();
+
+    // One chunk holds every array of the tree, and the tree keeps it alive
+    ASSERT_TRUE(!arena.expired());
+    ASSERT_EQUAL(arena.lock()->chunkCount(), size_t(1));
+    ASSERT_TRUE(arena.lock()->bytesUsed() > points.size() * 3 * sizeof(int));
+    ASSERT_TRUE(matchesBruteForce(*tree, points, 3, seed));
+    tree.reset();
+    ASSERT_TRUE(arena.expired());
+
+    // A small first chunk just grows; cascading arrays come from the arena as well
+    options.arena = std::make_shared<Arena>(64);
+    options.fractional_cascading = true;
+    RangeTree<int, 3> cascading_tree(points, options);
+    ASSERT_TRUE(options.arena->chunkCount() > 1);
+    ASSERT_TRUE(matchesBruteForce(cascading_tree, points, 3, seed));
+
+    Arena aligned(256);
+    aligned.allocate(3, 1);
+    void *block = aligned.allocate(1000, 64);
+    ASSERT_EQUAL(reinterpret_cast<uintptr_t>(block) % 64, uintptr_t(0));
+    ASSERT_EQUAL(aligned.chunkCount(), size_t(2));
+}
+
+// The column kernel in use (SIMD where the build targets it) must agree with the portable one
+template <typename T>
+bool kernelMatchesPortable(unsigned &seed)
+{
+    std::vector<T> columns(2 * 64);
+    for (size_t i = 0; i < columns.size(); i++)
+        columns[i] = static_cast<T>(static_cast<int>(nextRandom(seed) % 40) - 20) / 2;
+    if (std::numeric_limits<T>::has_quiet_NaN)
+        columns[5] = columns[64 + 6] = std::numeric_limits<T>::quiet_NaN();
+
+    for (size_t count = 1; count <= 64; count++)
+    {
+        for (int q = 0; q < 8; q++)
+        {
+            T low[2], high[2];
+            for (int d = 0; d < 2; d++)
+            {
+                low[d] = static_cast<T>(static_cast<int>(nextRandom(seed) % 30) - 15) / 2;
+                high[d] = low[d] + static_cast<T>(nextRandom(seed) % 20) / 2;
+            }
+            const size_t first = 64 - count;
+            uint64_t expected = columnMask(columns.data() + first, count, low[0], high[0], Portable<T>()) &
+                                columnMask(columns.data() + 64 + first, count, low[1], high[1], Portable<T>());
+            if (bucketMask(columns.data(), size_t(64), 0, 2, first, count, low, high) != expected)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Leaf buckets change how the bottom of every level is searched, never the answer
+TEST(test_leaf_buckets)
+{
+    unsigned seed = 3141;
+    auto points_2d = randomPoints(700, 2, 20, seed);
+    auto points_3d = randomPoints(700, 3, 20, seed);
+    auto points_4d = randomPoints(400, 4, 20, seed);
+
+    std::vector<RangeTree<int, 3>::Box> boxes;
+    for (int q = 0; q < 100; q++)
+    {
+        RangeTree<int, 3>::Box box;
+        for (int d = 0; d < 3; d++)
+        {
+            box.low[d] = nextRandom(seed) % 22 - 1;
+            box.high[d] = box.low[d] + static_cast<int>(nextRandom(seed) % 12);
+        }
+        boxes.push_back(box);
+    }
+
+    RangeTree<int, 3> reference(points_3d, BuildOptions());
+    bool same_hits = true;
+    for (size_t leaf_size : {0, 1, 8, 32, 128, 1000})
+    {
+        BuildOptions options;
+        options.leaf_size = leaf_size;
+        RangeTree<int, 2> tree_2d(points_2d, options);
+        RangeTree<int, 3> tree_3d(points_3d, options);
+        RangeTree<int, 4> tree_4d(points_4d, options);
+        ASSERT_TRUE(matchesBruteForce(tree_2d, points_2d, 2, seed));
+        ASSERT_TRUE(matchesBruteForce(tree_3d, points_3d, 3, seed));
+        ASSERT_TRUE(matchesBruteForce(tree_4d, points_4d, 4, seed));
+        ASSERT_TRUE(batchMatchesSingle(tree_3d, boxes));
+
+        options.fractional_cascading = true;
+        RangeTree<int, 3> cascading_3d(points_3d, options);
+        ASSERT_TRUE(matchesBruteForce(cascading_3d, points_3d, 3, seed));
+
+        for (const auto &box : boxes)
+        {
+            if (hitIndices(tree_3d, box.low, box.high) != hitIndices(reference, box.low, box.high) ||
+                hitIndices(cascading_3d, box.low, box.high) != hitIndices(reference, box.low, box.high))
+                same_hits = false;
+        }
+    }
+    ASSERT_TRUE(same_hits);
+
+    ASSERT_TRUE(kernelMatchesPortable<int>(seed));
+    ASSERT_TRUE(kernelMatchesPortable<float>(seed));
+    ASSERT_TRUE(kernelMatchesPortable<double>(seed));
+
+    // Floating-point trees take the same kernels
+    std::vector<RangeTree<double, 2>::Point> points_double;
+    for (const auto &point : points_2d)
+        points_double.push_back({{point[0] / 2.0, point[1] / 4.0}});
+    RangeTree<double, 2> tree_double(points_double);
+    RangeTree<double, 2>::Point low_double = {{1.5, 0.75}}, high_double = {{6.0, 3.0}};
+    size_t expected = 0;
+    for (const auto &point : points_double)
+    {
+        if (point[0] >= 1.5 && point[0] <= 6.0 && point[1] >= 0.75 && point[1] <= 3.0)
+            expected++;
+    }
+    ASSERT_EQUAL(tree_double.rangeCount(low_double, high_double), expected);
+}
+
+// Columns come back in the requested order and line up with the row results
+TEST(test_column_results)
+{
+    unsigned seed = 2718;
+    auto points = randomPoints(500, 4, 20, seed);
+    RangeTree<int, 3> tree(points); // The unindexed fourth coordinate is stored too
+    std::vector<int> low = {2, 0, 5}, high = {15, 12, 18};
+
+    auto rows = tree.rangeSearch(low, high);
+    auto columns = tree.rangeSearchColumns(low, high, {2, 0, 3});
+    ASSERT_EQUAL(columns.size(), size_t(3));
+    ASSERT_EQUAL(columns[0].size(), rows.size());
+    bool aligned = true;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        std::vector<int> indexed(rows[i].begin(), rows[i].begin() + 3);
+        if (rows[i].size() != 4 || columns[0][i] != rows[i][2] || columns[1][i] != rows[i][0] ||
+            columns[2][i] != rows[i][3] || !isPointInRange(indexed, low, high))
+            aligned = false;
+    }
+    ASSERT_TRUE(aligned);
+    ASSERT_TRUE(tree.rangeSearchColumns(low, high, {}).empty());
+
+    RangeTree<int, 1> tree_1d(points);
+    std::vector<int> low_1d = {4}, high_1d = {9};
+    auto columns_1d = tree_1d.rangeSearchColumns(low_1d, high_1d, {0});
+    ASSERT_EQUAL(columns_1d.size(), size_t(1));
+    ASSERT_EQUAL(columns_1d[0].size(), tree_1d.rangeSearch(low_1d, high_1d).size());
+
+    bool rejected = false;
+    try
+    {
+        tree.rangeSearchColumns(low, high, {4});
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+
+    // Points of different widths come back exactly as they went in
+    std::vector<std::vector<int>> ragged = {{1, 2}, {3, 4, 5}, {2, 3, 9, 9}, {7, 7}};
+    RangeTree<int, 2> tree_ragged(ragged);
+    std::vector<int> low_ragged = {0, 0}, high_ragged = {5, 5};
+    auto rows_ragged = tree_ragged.rangeSearch(low_ragged, high_ragged);
+    std::sort(rows_ragged.begin(), rows_ragged.end());
+    std::vector<std::vector<int>> expected_ragged = {{1, 2}, {2, 3, 9, 9}, {3, 4, 5}};
+    ASSERT_TRUE(rows_ragged == expected_ragged);
+    rejected = false;
+    try
+    {
+        tree_ragged.rangeSearchColumns(low_ragged, high_ragged, {2});
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+}
+
+// Levels index their axis at compile time; trees over trailing dimensions shift every axis
+template <size_t K>
+bool matchesTrailingBruteForce(const std::vector<std::vector<int>> &points, size_t first, unsigned &seed)
+{
+    BuildOptions cascading;
+    cascading.fractional_cascading = true;
+    RangeTree<int, K> tree(points, first);
+    RangeTree<int, K> cascading_tree(points, cascading, first);
+    for (int q = 0; q < 60; q++)
+    {
+        // Bounds of the leading dimensions are inverted: they must be ignored
+        std::vector<int> low(first, 5), high(first, -5);
+        for (size_t d = 0; d < K; d++)
+        {
+            int a = nextRandom(seed) % 22 - 1;
+            int b = nextRandom(seed) % 22 - 1;
+            low.push_back(std::min(a, b));
+            high.push_back(std::max(a, b));
+        }
+
+        size_t expected = 0;
+        for (const auto &point : points)
+        {
+            bool inside = true;
+            for (size_t d = first; d < first + K; d++)
+                inside = inside && point[d] >= low[d] && point[d] <= high[d];
+            if (inside)
+                expected++;
+        }
+        if (tree.rangeCount(low, high) != expected || cascading_tree.rangeCount(low, high) != expected ||
+            tree.rangeSearch(low, high).size() != expected)
+            return false;
+    }
+    return tree.search(points[3]) && cascading_tree.search(points[5]);
+}
+
+// Trees over leading and trailing dimensions of 5D points, with the axis of every level fixed at compile time
+TEST(test_compile_time_axes)
+{
+    unsigned seed = 1414;
+    auto points = randomPoints(500, 5, 20, seed);
+    ASSERT_TRUE(matchesTrailingBruteForce<3>(points, 0, seed));
+    ASSERT_TRUE(matchesTrailingBruteForce<3>(points, 2, seed));
+    ASSERT_TRUE(matchesTrailingBruteForce<4>(points, 0, seed));
+    ASSERT_TRUE(matchesTrailingBruteForce<4>(points, 1, seed));
+    ASSERT_TRUE(matchesTrailingBruteForce<2>(points, 3, seed));
+    ASSERT_TRUE(matchesTrailingBruteForce<1>(points, 4, seed));
+
+    // Rows keep the leading coordinates, and an image keeps the shift
+    RangeTree<int, 3> trailing(points, 2);
+    std::vector<int> low = {0, 0, 3, 3, 3}, high = {0, 0, 15, 15, 15};
+    auto rows = trailing.rangeSearch(low, high);
+    ASSERT_TRUE(!rows.empty() && rows[0].size() == 5);
+    const char *path = "range_tree_test_image.bin";
+    trailing.save(path);
+    auto reopened = RangeTree<int, 3>::open(path);
+    ASSERT_EQUAL(reopened.rangeCount(low, high), rows.size());
+    std::remove(path);
+}
+
+// Orders integers by magnitude, so -3 and 3 are equivalent and no vector kernel applies
+struct ByMagnitude
+{
+    bool operator()(int a, int b) const { return std::abs(a) < std::abs(b); }
+};
+
+struct Station
+{
+    std::string name;
+    double lat, lon;
+};
+
+// Records indexed through a projection, and trees ordered by a custom comparator
+TEST(test_records_and_comparator)
+{
+    unsigned seed = 2718;
+    std::vector<Station> stations;
+    for (int i = 0; i < 600; i++)
+    {
+        stations.push_back({"s" + std::to_string(i), nextRandom(seed) % 1800 / 10.0 - 90.0,
+                            nextRandom(seed) % 3600 / 10.0 - 180.0});
+    }
+
+    // Records are indexed through a projection, and hits come back as their positions
+    for (size_t leaf_size : {0, 32})
+    {
+        BuildOptions options;
+        options.leaf_size = leaf_size;
+        RangeTree<double, 2> by_position(stations, [](const Station &s, size_t axis)
+                                         { return axis == 0 ? s.lat : s.lon; },
+                                         options);
+        bool same_hits = true;
+        for (int q = 0; q < 50; q++)
+        {
+            std::array<double, 2> low = {{nextRandom(seed) % 180 - 90.0, nextRandom(seed) % 360 - 180.0}};
+            std::array<double, 2> high = {{low[0] + nextRandom(seed) % 40, low[1] + nextRandom(seed) % 80}};
+            std::vector<uint32_t> expected;
+            for (uint32_t i = 0; i < stations.size(); i++)
+            {
+                if (stations[i].lat >= low[0] && stations[i].lat <= high[0] &&
+                    stations[i].lon >= low[1] && stations[i].lon <= high[1])
+                {
+                    expected.push_back(i);
+                }
+            }
+            same_hits = same_hits && by_position.rangeSearchIndices(low, high) == expected;
+        }
+        ASSERT_TRUE(same_hits);
+    }
+
+    // Under std::greater a box runs from its largest to its smallest value
+    auto points = randomPoints(700, 3, 20, seed);
+    RangeTree<int, 3> ascending(points);
+    for (bool cascading : {false, true})
+    {
+        BuildOptions options;
+        options.fractional_cascading = cascading;
+        options.leaf_size = 8;
+        RangeTree<int, 3, std::greater<int>> descending(points, options);
+        bool same_counts = true;
+        for (int q = 0; q < 100; q++)
+        {
+            std::vector<int> low(3), high(3);
+            for (int d = 0; d < 3; d++)
+            {
+                low[d] = nextRandom(seed) % 22 - 1;
+                high[d] = low[d] + static_cast<int>(nextRandom(seed) % 12);
+            }
+            same_counts = same_counts && descending.rangeCount(high, low) == ascending.rangeCount(low, high) &&
+                          descending.rangeSearchIndices(high, low) == ascending.rangeSearchIndices(low, high);
+        }
+        ASSERT_TRUE(same_counts);
+    }
+
+    // A comparator with non-trivial equivalence classes, through buckets and the 1D level
+    std::vector<std::vector<int>> signed_points;
+    for (const auto &point : points)
+    {
+        signed_points.push_back({point[0] - 10, point[1] - 10});
+    }
+    for (size_t leaf_size : {0, 4})
+    {
+        BuildOptions options;
+        options.leaf_size = leaf_size;
+        options.fractional_cascading = leaf_size == 0;
+        RangeTree<int, 2, ByMagnitude> magnitude(signed_points, options);
+        RangeTree<int, 1, ByMagnitude> magnitude_1d(signed_points, options);
+        bool same_hits = true;
+        for (int q = 0; q < 100; q++)
+        {
+            std::vector<int> low = {static_cast<int>(nextRandom(seed) % 8), -static_cast<int>(nextRandom(seed) % 8)};
+            std::vector<int> high = {low[0] + static_cast<int>(nextRandom(seed) % 4), -std::abs(low[1]) - 3};
+            std::vector<uint32_t> expected_2d, expected_1d;
+            for (uint32_t i = 0; i < signed_points.size(); i++)
+            {
+                const int x = std::abs(signed_points[i][0]), y = std::abs(signed_points[i][1]);
+                if (x >= low[0] && x <= high[0])
+                {
+                    expected_1d.push_back(i);
+                    if (y >= std::abs(low[1]) && y <= std::abs(high[1]))
+                    {
+                        expected_2d.push_back(i);
+                    }
+                }
+            }
+            same_hits = same_hits && magnitude.rangeSearchIndices(low, high) == expected_2d &&
+                        magnitude_1d.rangeSearchIndices(low, high) == expected_1d;
+        }
+        ASSERT_TRUE(same_hits);
+    }
+}
+
+// Whether value passes one side of a query box in the natural order
+bool passesSide(int value, int bound, Bound kind, bool lower)
+{
+    if (kind == Bound::Unbounded)
+    {
+        return true;
+    }
+    if (kind == Bound::Closed)
+    {
+        return lower ? value >= bound : value <= bound;
+    }
+    return lower ? value > bound : value < bound;
+}
+
+// Every mix of open, closed and unbounded sides against a brute-force scan, on every layout
+TEST(test_query_box)
+{
+    unsigned seed = 1618;
+    auto points = randomPoints(800, 3, 20, seed);
+    const Bound kinds[] = {Bound::Unbounded, Bound::Closed, Bound::Open};
+
+    bool same_hits = true;
+    for (size_t leaf_size : {0, 8})
+    {
+        for (bool cascading : {false, true})
+        {
+            BuildOptions options;
+            options.leaf_size = leaf_size;
+            options.fractional_cascading = cascading;
+            RangeTree<int, 3> tree_3d(points, options);
+            RangeTree<int, 2> tree_2d(points, options);
+            RangeTree<int, 1> tree_1d(points, options);
+            for (int q = 0; q < 300; q++)
+            {
+                QueryBox<int, 3> box;
+                for (int d = 0; d < 3; d++)
+                {
+                    const int low = nextRandom(seed) % 22 - 1;
+                    box.lower(d, low, kinds[nextRandom(seed) % 3]);
+                    box.upper(d, low + static_cast<int>(nextRandom(seed) % 12), kinds[nextRandom(seed) % 3]);
+                }
+
+                // The same sides seen by the lower-dimensional trees
+                QueryBox<int, 2> box_2d;
+                QueryBox<int, 1> box_1d;
+                for (int d = 0; d < 2; d++)
+                {
+                    box_2d.lower(d, box.low[d], box.low_kind[d]).upper(d, box.high[d], box.high_kind[d]);
+                }
+                box_1d.lower(0, box.low[0], box.low_kind[0]).upper(0, box.high[0], box.high_kind[0]);
+
+                std::vector<uint32_t> expected_3d, expected_2d, expected_1d;
+                for (uint32_t i = 0; i < points.size(); i++)
+                {
+                    bool inside = true;
+                    for (int d = 0; d < 3; d++)
+                    {
+                        inside = inside && passesSide(points[i][d], box.low[d], box.low_kind[d], true) &&
+                                 passesSide(points[i][d], box.high[d], box.high_kind[d], false);
+                        if (inside && d == 0)
+                        {
+                            expected_1d.push_back(i);
+                        }
+                        if (inside && d == 1)
+                        {
+                            expected_2d.push_back(i);
+                        }
+                    }
+                    if (inside)
+                    {
+                        expected_3d.push_back(i);
+                    }
+                }
+                same_hits = same_hits && tree_3d.rangeSearchIndices(box) == expected_3d &&
+                            tree_3d.rangeCount(box) == expected_3d.size() &&
+                            tree_3d.rangeSearch(box).size() == expected_3d.size() &&
+                            tree_2d.rangeSearchIndices(box_2d) == expected_2d &&
+                            tree_1d.rangeSearchIndices(box_1d) == expected_1d;
+            }
+        }
+    }
+    ASSERT_TRUE(same_hits);
+
+    // A default box holds everything, and an open bound past the last value nothing
+    RangeTree<int, 3> tree(points);
+    ASSERT_EQUAL(tree.rangeCount(QueryBox<int, 3>()), points.size());
+    QueryBox<int, 3> beyond;
+    beyond.lower(1, std::numeric_limits<int>::max(), Bound::Open);
+    ASSERT_EQUAL(tree.rangeCount(beyond), 0);
+
+    // Half-open tiles of a float axis count every point exactly once
+    std::vector<std::array<float, 2>> samples;
+    for (int i = 0; i < 500; i++)
+    {
+        samples.push_back({{static_cast<float>(nextRandom(seed) % 1000) / 100.0f, 0.0f}});
+    }
+    samples.push_back({{2.5f, 1.0f}});
+    RangeTree<float, 2> float_tree(samples);
+    size_t tiled = 0;
+    for (int tile = 0; tile < 8; tile++)
+    {
+        QueryBox<float, 2> box;
+        box.lower(0, tile * 1.25f).upper(0, (tile + 1) * 1.25f, Bound::Open);
+        tiled += float_tree.rangeCount(box);
+    }
+    ASSERT_EQUAL(tiled, samples.size());
+    QueryBox<float, 2> above_zero;
+    above_zero.lower(1, 0.0f, Bound::Open);
+    ASSERT_EQUAL(float_tree.rangeCount(above_zero), 1);
+
+    // Under std::greater the lower side is the larger value
+    RangeTree<int, 3, std::greater<int>> descending(points);
+    QueryBox<int, 3> reversed;
+    reversed.lower(0, 10, Bound::Open).upper(0, 4);
+    QueryBox<int, 3> natural;
+    natural.lower(0, 4).upper(0, 10, Bound::Open);
+    ASSERT_TRUE(descending.rangeSearchIndices(reversed) == tree.rangeSearchIndices(natural));
+
+    // Orders without known limits take closed sides only
+    RangeTree<int, 2, ByMagnitude> magnitude(points);
+    QueryBox<int, 2> closed;
+    closed.between(0, 2, 5).between(1, 0, 3);
+    ASSERT_EQUAL(magnitude.rangeCount(closed), magnitude.rangeCount({2, 0}, {5, 3}));
+    bool rejected = false;
+    try
+    {
+        magnitude.rangeCount(QueryBox<int, 2>().between(0, 2, 5));
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+}
+
+// Sums, maxima and minima over boxes, against a reduction of the brute-force hits
+template <size_t K>
+bool aggregatesMatchBruteForce(const std::vector<std::vector<int>> &points, const BuildOptions &options, unsigned &seed)
+{
+    std::vector<std::array<int, K>> array_points(points.size());
+    std::vector<long long> weights(points.size());
+    std::vector<double> stamps(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        std::copy(points[i].begin(), points[i].begin() + K, array_points[i].begin());
+        weights[i] = nextRandom(seed) % 1000;
+        stamps[i] = nextRandom(seed) % 100000 / 7.0;
+    }
+    AggregateRangeTree<int, K, long long> sums(array_points, weights, options);
+    AggregateRangeTree<int, K, double, MaxOf<double>> latest(array_points, stamps, options);
+    AggregateRangeTree<int, K, double, MinOf<double>> earliest(array_points, stamps, options);
+
+    for (int q = 0; q < 100; q++)
+    {
+        std::array<int, K> low, high;
+        QueryBox<int, K> box;
+        for (size_t d = 0; d < K; d++)
+        {
+            low[d] = nextRandom(seed) % 22 - 1;
+            high[d] = low[d] + static_cast<int>(nextRandom(seed) % 14);
+            if (d + 1 < K || q % 2 == 0)
+            {
+                box.between(d, low[d], high[d]);
+            }
+        }
+
+        // Odd queries leave the last axis of the box unbounded
+        long long sum = 0, box_sum = 0;
+        double max_stamp = MaxOf<double>::identity(), min_stamp = MinOf<double>::identity();
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            bool inside = true, inside_box = true;
+            for (size_t d = 0; d < K; d++)
+            {
+                const bool within = array_points[i][d] >= low[d] && array_points[i][d] <= high[d];
+                inside = inside && within;
+                inside_box = inside_box && (within || (d + 1 == K && q % 2));
+            }
+            if (inside)
+            {
+                sum += weights[i];
+                max_stamp = std::max(max_stamp, stamps[i]);
+                min_stamp = std::min(min_stamp, stamps[i]);
+            }
+            if (inside_box)
+            {
+                box_sum += weights[i];
+            }
+        }
+        if (sums.rangeAggregate(low, high) != sum || latest.rangeAggregate(low, high) != max_stamp ||
+            earliest.rangeAggregate(low, high) != min_stamp || sums.rangeAggregate(box) != box_sum)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Monoid aggregates over boxes on every layout, plus empty boxes and mismatched values
+TEST(test_aggregate_queries)
+{
+    unsigned seed = 5772;
+    auto points = randomPoints(900, 3, 20, seed);
+    for (size_t leaf_size : {0, 8})
+    {
+        for (bool cascading : {false, true})
+        {
+            BuildOptions options;
+            options.leaf_size = leaf_size;
+            options.fractional_cascading = cascading;
+            ASSERT_TRUE(aggregatesMatchBruteForce<1>(points, options, seed));
+            ASSERT_TRUE(aggregatesMatchBruteForce<2>(points, options, seed));
+            ASSERT_TRUE(aggregatesMatchBruteForce<3>(points, options, seed));
+        }
+    }
+
+    // An empty box aggregates to the identity, and values must match the points
+    std::vector<std::array<int, 2>> corners = {{{0, 0}}, {{5, 5}}};
+    AggregateRangeTree<int, 2, int> counts(corners, {1, 1});
+    ASSERT_EQUAL(counts.rangeAggregate({{1, 1}}, {{4, 4}}), 0);
+    ASSERT_EQUAL(counts.rangeAggregate({{0, 0}}, {{5, 5}}), 2);
+    ASSERT_EQUAL(counts.rangeTree().rangeCount(std::array<int, 2>{{0, 0}}, std::array<int, 2>{{5, 5}}), 2);
+    bool rejected = false;
+    try
+    {
+        AggregateRangeTree<int, 2, int> mismatched(corners, {1});
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+}
+
+// The k highest-priority points of a box, ties in input order, against a sorted brute force
+TEST(test_top_k)
+{
+    unsigned seed = 6931;
+    auto points = randomPoints(1000, 2, 30, seed);
+    std::vector<std::array<int, 2>> array_points;
+    std::vector<int> priorities;
+    for (const auto &point : points)
+    {
+        array_points.push_back({{point[0], point[1]}});
+        priorities.push_back(nextRandom(seed) % 50); // Many ties
+    }
+
+    bool same_top = true;
+    for (size_t leaf_size : {0, 8})
+    {
+        for (bool cascading : {false, true})
+        {
+            BuildOptions options;
+            options.leaf_size = leaf_size;
+            options.fractional_cascading = cascading;
+            TopKRangeTree<int, 2, int> ranked(array_points, priorities, options);
+            for (int q = 0; q < 100; q++)
+            {
+                std::array<int, 2> low = {{static_cast<int>(nextRandom(seed) % 30) - 1, static_cast<int>(nextRandom(seed) % 30) - 1}};
+                std::array<int, 2> high = {{low[0] + static_cast<int>(nextRandom(seed) % 20), low[1] + static_cast<int>(nextRandom(seed) % 20)}};
+                const size_t k = nextRandom(seed) % 40;
+
+                // Brute force: every hit, highest key first and input order among ties
+                std::vector<uint32_t> expected;
+                for (uint32_t i = 0; i < array_points.size(); i++)
+                {
+                    if (array_points[i][0] >= low[0] && array_points[i][0] <= high[0] &&
+                        array_points[i][1] >= low[1] && array_points[i][1] <= high[1])
+                    {
+                        expected.push_back(i);
+                    }
+                }
+                std::stable_sort(expected.begin(), expected.end(), [&priorities](uint32_t a, uint32_t b)
+                                 { return priorities[a] > priorities[b]; });
+                expected.resize(std::min(k, expected.size()));
+
+                QueryBox<int, 2> box;
+                box.between(0, low[0], high[0]).between(1, low[1], high[1]);
+                same_top = same_top && ranked.rangeTopK(low, high, k) == expected && ranked.rangeTopK(box, k) == expected;
+            }
+        }
+    }
+    ASSERT_TRUE(same_top);
+
+    // A box holding everything returns the global order, however large k is
+    TopKRangeTree<int, 2, int> ranked(array_points, priorities);
+    auto all = ranked.rangeTopK(QueryBox<int, 2>(), array_points.size() + 10);
+    ASSERT_EQUAL(all.size(), array_points.size());
+    ASSERT_TRUE(ranked.rangeTopK(QueryBox<int, 2>(), 0).empty());
+    bool ordered = true;
+    for (size_t i = 1; i < all.size(); i++)
+    {
+        ordered = ordered && priorities[all[i - 1]] >= priorities[all[i]];
+    }
+    ASSERT_TRUE(ordered);
+}
+
+// Per-level counts, heights and bytes of known tree shapes, with and without cascading or buckets
+TEST(test_tree_stats)
+{
+    unsigned seed = 1123;
+    auto points = randomPoints(1000, 3, 50, seed);
+
+    // Without buckets every depth of a level gets an associated forest over all points
+    BuildOptions plain;
+    plain.leaf_size = 0;
+    RangeTree<int, 2> tree_2d(points, plain);
+    TreeStats stats = tree_2d.stats();
+    ASSERT_EQUAL(stats.points, 1000);
+    ASSERT_EQUAL(stats.levels.size(), 2);
+    ASSERT_EQUAL(stats.levels[0].trees, 1);
+    ASSERT_EQUAL(stats.levels[0].height, 10);
+    ASSERT_EQUAL(stats.levels[1].forests, 10);
+    ASSERT_EQUAL(stats.levels[1].trees, 1000);
+    ASSERT_EQUAL(stats.levels[1].references, 10000);
+    ASSERT_EQUAL(stats.references(), 11000);
+    ASSERT_TRUE(stats.levels[0].balance == 1.0 && stats.levels[1].balance == 1.0);
+    ASSERT_EQUAL(stats.point_bytes, 3000 * sizeof(int)); // The unindexed third column counts too
+    ASSERT_EQUAL(stats.nodeBytes(), 1000 * (sizeof(uint32_t) + sizeof(int)));
+
+    // Cascading replaces the associated 1D trees with subsets and bridges
+    BuildOptions cascading = plain;
+    cascading.fractional_cascading = true;
+    TreeStats layered = RangeTree<int, 2>(points, cascading).stats();
+    ASSERT_TRUE(layered.levels[1].forests == 0 && layered.levels[0].cascade_bytes > 0);
+
+    // Buckets cut the associated levels short; an arena holds exactly the counted arrays
+    BuildOptions bucketed;
+    bucketed.arena = std::make_shared<Arena>();
+    RangeTree<int, 3> tree_3d(points, bucketed);
+    TreeStats stats_3d = tree_3d.stats();
+    ASSERT_TRUE(stats_3d.levels[1].forests < 10 && stats_3d.levels[0].bucket_bytes == 3000 * sizeof(int));
+    ASSERT_TRUE(stats_3d.levels[2].references > 0 && stats_3d.associatedBytes() > stats_3d.nodeBytes());
+    const size_t arrays = 1 + 3 * (stats_3d.levels[0].forests + stats_3d.levels[1].forests + stats_3d.levels[2].forests);
+    const size_t used = bucketed.arena->bytesUsed();
+    ASSERT_TRUE(stats_3d.bytes() <= used && used - stats_3d.bytes() < 16 * arrays); // Alignment padding only
+
+    RangeTree<int, 1> empty(std::vector<std::vector<int>>{});
+    ASSERT_EQUAL(empty.stats().references(), 0);
+}
+
+// Per-query counters stay within the traversal bounds and add up per thread, when compiled in
+TEST(test_query_stats)
+{
+    unsigned seed = 2501;
+    auto points = randomPoints(1024, 2, 100, seed);
+    BuildOptions plain;
+    plain.leaf_size = 0;
+    RangeTree<int, 2> tree(points, plain);
+
+    threadQueryStats() = QueryStats();
+    std::vector<int> low = {20, 30}, high = {70, 60};
+    const size_t hits = tree.rangeSearch(low, high).size();
+    const QueryStats stats = threadQueryStats();
+
+#if RANGE_TREE_QUERY_STATS
+    // One split path and two boundary paths per level, one canonical subtree per step
+    ASSERT_EQUAL(stats.points_reported, hits);
+    ASSERT_TRUE(stats.nodes_visited > 0 && stats.nodes_visited <= 3 * 11 * 11);
+    ASSERT_TRUE(stats.canonical_subtrees > 0 && stats.canonical_subtrees <= 2 * 11);
+    ASSERT_TRUE(stats.points_tested > 0 && stats.points_tested <= 2 * 11);
+    ASSERT_EQUAL(stats.bucket_scans, 0);
+
+    // Counters add up per thread until reset
+    tree.rangeSearch(low, high);
+    ASSERT_EQUAL(threadQueryStats().points_reported, 2 * hits);
+    std::thread other([&tree, &low, &high]() { tree.rangeSearch(low, high); });
+    other.join();
+    ASSERT_EQUAL(threadQueryStats().points_reported, 2 * hits);
+
+    RangeTree<int, 2> bucketed(points);
+    threadQueryStats() = QueryStats();
+    ASSERT_EQUAL(bucketed.rangeCount(low, high), hits);
+    ASSERT_TRUE(threadQueryStats().bucket_scans > 0 && threadQueryStats().bucket_points >= threadQueryStats().bucket_scans);
+#else
+    // Compiled out: the counters are never touched
+    ASSERT_TRUE(hits > 0);
+    ASSERT_EQUAL(stats.nodes_visited + stats.canonical_subtrees + stats.points_tested, 0);
+    ASSERT_EQUAL(stats.bucket_scans + stats.bucket_points + stats.points_reported, 0);
+#endif
+}
+
+// Moved-in points and iterator ranges build the same tree as a copied vector
+TEST(test_owning_constructors)
+{
+    unsigned seed = 2602;
+    std::vector<std::array<int, 3>> points;
+    for (const auto &point : randomPoints(777, 3, 40, seed))
+    {
+        points.push_back({point[0], point[1], point[2]});
+    }
+    RangeTree<int, 3> copied(points);
+
+    // Moving the points in transposes them in place; with an arena they are copied into it
+    auto moving = points;
+    RangeTree<int, 3> moved(std::move(moving));
+    ASSERT_TRUE(moving.empty());
+    BuildOptions arena_options;
+    arena_options.arena = std::make_shared<Arena>();
+    auto into_arena = points;
+    RangeTree<int, 3> arena_moved(std::move(into_arena), arena_options);
+    ASSERT_TRUE(into_arena.empty());
+
+    // Ranges are read through any forward iterator, a pointer span included
+    std::deque<std::array<int, 3>> queued(points.begin(), points.end());
+    RangeTree<int, 3> from_deque(queued.begin(), queued.end());
+    RangeTree<int, 3> from_span(points.data(), points.data() + points.size());
+    ASSERT_EQUAL(from_span.stats().points, points.size());
+
+    bool same = true;
+    for (int q = 0; q < 200; ++q)
+    {
+        std::array<int, 3> low, high;
+        for (int d = 0; d < 3; ++d)
+        {
+            int a = nextRandom(seed) % 40, b = nextRandom(seed) % 40;
+            low[d] = std::min(a, b);
+            high[d] = std::max(a, b);
+        }
+        auto expected = copied.rangeSearch(low, high);
+        same = same && moved.rangeSearch(low, high) == expected && arena_moved.rangeSearch(low, high) == expected &&
+               from_deque.rangeSearch(low, high) == expected && from_span.rangeSearch(low, high) == expected;
+    }
+    ASSERT_TRUE(same);
+
+    // Odd shapes of the transposition: one point, no points, one axis
+    std::vector<std::array<int, 3>> single = {{{4, 5, 6}}};
+    RangeTree<int, 3> one(std::move(single));
+    auto found = one.rangeSearch(std::array<int, 3>{{0, 0, 0}}, std::array<int, 3>{{9, 9, 9}});
+    ASSERT_TRUE(found.size() == 1 && found[0][2] == 6);
+    RangeTree<int, 2> none(std::vector<std::array<int, 2>>{});
+    ASSERT_EQUAL(none.stats().points, 0);
+    std::vector<std::array<double, 1>> line = {{{3.0}}, {{1.0}}, {{2.0}}};
+    RangeTree<double, 1> line_tree(std::move(line));
+    ASSERT_EQUAL(line_tree.rangeCount(std::array<double, 1>{{1.5}}, std::array<double, 1>{{3.0}}), 2);
+}
+
+std::string fileContents(const char *path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Images built out of core are byte for byte the images save() writes
+TEST(test_external_build)
+{
+    const char *path = "range_tree_test_image.bin";
+    const char *external_path = "range_tree_test_external.bin";
+
+    // Distinct coordinates on every axis leave the sorts no ties to break differently
+    const int n = 3000;
+    std::vector<std::array<int, 3>> points(n);
+    for (int i = 0; i < n; ++i)
+    {
+        points[i] = {{i * 7 % n, (i * 11 + 5) % n, (i * 13 + 9) % n}};
+    }
+
+    // A budget of a few hundred records forces merged runs and two-pass splits
+    ExternalBuildOptions small;
+    small.memory_budget = 8 << 10;
+    ExternalBuilder<int, 3>(small).build(points.begin(), points.end(), external_path);
+    RangeTree<int, 3>(points).save(path);
+    ASSERT_TRUE(fileContents(external_path) == fileContents(path));
+
+    small.leaf_size = 0;
+    std::vector<std::array<int, 2>> points_2d;
+    for (const auto &point : points)
+    {
+        points_2d.push_back({{point[0], point[1]}});
+    }
+    BuildOptions unbucketed;
+    unbucketed.leaf_size = 0;
+    ExternalBuilder<int, 2>(small).build(points_2d.begin(), points_2d.end(), external_path);
+    RangeTree<int, 2>(points_2d, unbucketed).save(path);
+    ASSERT_TRUE(fileContents(external_path) == fileContents(path));
+
+    std::vector<std::array<int, 1>> points_1d;
+    for (const auto &point : points)
+    {
+        points_1d.push_back({{point[2]}});
+    }
+    ExternalBuilder<int, 1>(small).build(points_1d.begin(), points_1d.end(), external_path);
+    RangeTree<int, 1>(points_1d).save(path);
+    ASSERT_TRUE(fileContents(external_path) == fileContents(path));
+
+    // Raw points from a file, with duplicates: the image answers like an in-memory tree
+    unsigned seed = 2727;
+    std::vector<std::array<int, 3>> repeated;
+    for (const auto &point : randomPoints(2000, 3, 20, seed))
+    {
+        repeated.push_back({{point[0], point[1], point[2]}});
+    }
+    {
+        std::ofstream raw(path, std::ios::binary);
+        raw.write(reinterpret_cast<const char *>(repeated.data()), repeated.size() * sizeof(repeated[0]));
+    }
+    ExternalBuildOptions defaults;
+    ExternalBuilder<int, 3>(defaults).buildFromFile(path, external_path);
+    RangeTree<int, 3> mapped = RangeTree<int, 3>::open(external_path);
+    RangeTree<int, 3> in_memory(repeated);
+    bool same = true;
+    for (int q = 0; q < 100; ++q)
+    {
+        std::array<int, 3> low, high;
+        for (int d = 0; d < 3; ++d)
+        {
+            low[d] = nextRandom(seed) % 20;
+            high[d] = low[d] + static_cast<int>(nextRandom(seed) % 8);
+        }
+        same = same && mapped.rangeSearchIndices(low, high) == in_memory.rangeSearchIndices(low, high);
+    }
+    ASSERT_TRUE(same);
+
+    std::vector<std::array<int, 2>> none;
+    ExternalBuilder<int, 2>().build(none.begin(), none.end(), external_path);
+    std::array<int, 2> everywhere_low = {{0, 0}}, everywhere_high = {{9, 9}};
+    const size_t empty_hits = RangeTree<int, 2>::open(external_path).rangeCount(everywhere_low, everywhere_high);
+    ASSERT_EQUAL(empty_hits, 0);
+
+    // A truncated point file is refused
+    std::ofstream(path, std::ios::binary) << "odd";
+    bool rejected = false;
+    try
+    {
+        ExternalBuilder<int, 3>().buildFromFile(path, external_path);
+    }
+    catch (const std::runtime_error &)
+    {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+    std::remove(path);
+    std::remove(external_path);
+}
+
+// A tree over coordinate ranks answers exactly like the tree over the coordinates
+TEST(test_rank_space)
+{
+    unsigned seed = 2828;
+    std::vector<std::array<double, 3>> points;
+    for (const auto &point : randomPoints(1500, 3, 60, seed))
+    {
+        points.push_back({{point[0] * 0.25, point[1] - 30.5, point[2] * 1e6}});
+    }
+    RangeTree<double, 3> plain(points);
+    RankSpaceRangeTree<double, 3> ranked(points);
+
+    bool same = true;
+    for (int q = 0; q < 200; ++q)
+    {
+        std::array<double, 3> low, high;
+        for (int d = 0; d < 3; ++d)
+        {
+            double a = (nextRandom(seed) % 70) - 5.0, b = (nextRandom(seed) % 70) - 5.0;
+            low[d] = std::min(a, b);
+            high[d] = std::max(a, b);
+        }
+        low[0] *= 0.25, high[0] *= 0.25;
+        low[1] -= 30.4, high[1] -= 30.6;
+        low[2] *= 1e6, high[2] *= 1e6;
+
+        same = same && ranked.rangeSearchIndices(low, high) == plain.rangeSearchIndices(low, high) &&
+               ranked.rangeCount(low, high) == plain.rangeCount(low, high);
+        auto found = ranked.rangeSearch(low, high), expected = plain.rangeSearch(low, high);
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        same = same && found == expected;
+
+        QueryBox<double, 3> box;
+        box.lower(0, low[0], Bound::Open).upper(1, high[1], Bound::Open).between(2, low[2], high[2]);
+        same = same && ranked.rangeSearchIndices(box) == plain.rangeSearchIndices(box) &&
+               ranked.rangeCount(box) == plain.rangeCount(box);
+    }
+    ASSERT_TRUE(same);
+    ASSERT_TRUE(ranked.search(points[17]) && !ranked.search({{0.3, 0.0, 0.0}}));
+    ASSERT_TRUE(ranked.values(0).size() <= 60 && ranked.values(0).front() == 0.0);
+
+    // Keys and columns drop from 8 to 4 bytes
+    TreeStats plain_stats = plain.stats(), ranked_stats = ranked.stats();
+    ASSERT_EQUAL(2 * ranked_stats.nodeBytes() - 1500 * sizeof(uint32_t), plain_stats.nodeBytes());
+    ASSERT_TRUE(2 * ranked_stats.associatedBytes() < plain_stats.associatedBytes() + ranked_stats.associatedBytes());
+
+    bool rejected = false;
+    try
+    {
+        RankSpaceRangeTree<double, 1> bad(std::vector<std::array<double, 1>>{{{std::nan("")}}});
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+}
+
+// Tree of one published version: every point has the version on axis 0
+struct VersionedTree
+{
+    int version;
+    RangeTree<int, 2> tree;
+    std::atomic<int> &alive;
+
+    VersionedTree(int v, std::atomic<int> &counter)
+        : version(v), tree(versionPoints(v)), alive(counter) { ++alive; }
+    ~VersionedTree() { --alive; }
+
+    static std::vector<std::array<int, 2>> versionPoints(int v)
+    {
+        std::vector<std::array<int, 2>> points;
+        for (int i = 0; i < 100 + v; ++i)
+        {
+            points.push_back({{v, i}});
+        }
+        return points;
+    }
+};
+
+// Snapshots pin their version, and racing readers only ever see whole, newer versions
+TEST(test_index_handle)
+{
+    std::atomic<int> alive(0);
+    IndexHandle<VersionedTree> handle(std::unique_ptr<VersionedTree>(new VersionedTree(0, alive)));
+
+    // A snapshot pins its version across a publish until it is dropped
+    {
+        auto pinned = handle.read();
+        handle.publish(std::unique_ptr<VersionedTree>(new VersionedTree(1, alive)));
+        ASSERT_TRUE(pinned->version == 0 && handle.retiredCount() == 1 && alive == 2);
+        ASSERT_EQUAL(handle.read()->version, 1);
+    }
+    ASSERT_EQUAL(handle.reclaim(), 1);
+    ASSERT_EQUAL(alive, 1);
+
+    // Readers racing a publisher only ever see whole versions, newer over time
+    std::atomic<bool> stop(false), consistent(true);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r)
+    {
+        readers.emplace_back([&handle, &stop, &consistent]() {
+            int last = 0;
+            std::array<int, 2> low = {{0, 0}}, high = {{1000, 1000}};
+            while (!stop)
+            {
+                auto snapshot = handle.read();
+                const VersionedTree &current = *snapshot;
+                if (current.version < last || current.tree.rangeCount(low, high) != 100 + static_cast<size_t>(current.version))
+                    consistent = false;
+                last = current.version;
+            }
+        });
+    }
+    for (int v = 2; v <= 60; ++v)
+    {
+        handle.publish(std::unique_ptr<VersionedTree>(new VersionedTree(v, alive)));
+    }
+    stop = true;
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+    handle.reclaim();
+    ASSERT_TRUE(consistent);
+    ASSERT_TRUE(alive == 1 && handle.retiredCount() == 0 && handle.version() == 60);
+    const int newest = handle.with([](const VersionedTree &t) { return t.version; });
+    ASSERT_EQUAL(newest, 60);
+}
+
+// Coincident points stored once still answer like a tree over every copy, with groups listing the copies
+TEST(test_multiset_points)
+{
+    // Few distinct values per axis: most points have several copies
+    unsigned seed = 3030;
+    std::vector<std::array<int, 3>> points;
+    for (const auto &point : randomPoints(4000, 3, 8, seed))
+    {
+        points.push_back({{point[0], point[1], point[2]}});
+    }
+    RangeTree<int, 3> plain(points);
+    MultisetRangeTree<int, 3> multiset(points);
+    ASSERT_TRUE(multiset.size() == 4000 && multiset.distinctSize() <= 512);
+
+    bool same = true;
+    for (int q = 0; q < 200; ++q)
+    {
+        std::array<int, 3> low, high;
+        for (int d = 0; d < 3; ++d)
+        {
+            low[d] = nextRandom(seed) % 8;
+            high[d] = low[d] + static_cast<int>(nextRandom(seed) % 4);
+        }
+        same = same && multiset.rangeCount(low, high) == plain.rangeCount(low, high) &&
+               multiset.rangeSearchIndices(low, high) == plain.rangeSearchIndices(low, high);
+        auto found = multiset.rangeSearch(low, high), expected = plain.rangeSearch(low, high);
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        same = same && found == expected;
+
+        // Each group lists the input positions of its copies
+        size_t copies = 0;
+        for (const auto &group : multiset.rangeSearchGroups(low, high))
+        {
+            copies += group.count();
+            for (const uint32_t *index = group.first; index != group.last; ++index)
+                same = same && points[*index] == *group.point;
+        }
+        same = same && copies == multiset.rangeCount(low, high) &&
+               multiset.distinctCount(low, high) == multiset.rangeSearchGroups(low, high).size();
+    }
+    ASSERT_TRUE(same);
+
+    QueryBox<int, 3> box;
+    box.lower(0, 2, Bound::Open).upper(2, 5);
+    ASSERT_EQUAL(multiset.rangeCount(box), plain.rangeCount(box));
+    ASSERT_TRUE(multiset.search(points[99]) && !multiset.search({{9, 9, 9}}));
+    ASSERT_TRUE(multiset.countTree().rangeTree().stats().references() * 4 < plain.stats().references());
+
+    MultisetRangeTree<int, 3> empty(std::vector<std::array<int, 3>>{});
+    ASSERT_EQUAL(empty.rangeCount({{0, 0, 0}}, {{9, 9, 9}}), 0);
+}
+
 int main()
 {
     test_file.open("range_tree_test_results.txt");
@@ -465,6 +2154,32 @@ int main()
     RUN_TEST(test_large_dataset);
     RUN_TEST(test_invalid_input);
     RUN_TEST(test_inverted_ranges);
+    RUN_TEST(test_query_matches_brute_force);
+    RUN_TEST(test_fractional_cascading);
+    RUN_TEST(test_array_point_api);
+    RUN_TEST(test_implicit_layout_sizes);
+    RUN_TEST(test_parallel_build);
+    RUN_TEST(test_visitor_range_search);
+    RUN_TEST(test_exact_match_search);
+    RUN_TEST(test_batch_queries);
+    RUN_TEST(test_concurrent_query_stress);
+    RUN_TEST(test_dynamic_insert_erase);
+    RUN_TEST(test_save_and_open_image);
+    RUN_TEST(test_arena_backed_build);
+    RUN_TEST(test_leaf_buckets);
+    RUN_TEST(test_column_results);
+    RUN_TEST(test_compile_time_axes);
+    RUN_TEST(test_records_and_comparator);
+    RUN_TEST(test_query_box);
+    RUN_TEST(test_aggregate_queries);
+    RUN_TEST(test_top_k);
+    RUN_TEST(test_tree_stats);
+    RUN_TEST(test_query_stats);
+    RUN_TEST(test_owning_constructors);
+    RUN_TEST(test_external_build);
+    RUN_TEST(test_rank_space);
+    RUN_TEST(test_index_handle);
+    RUN_TEST(test_multiset_points);
 
     // Output test summary
     test_file << std::endl;